@@ -0,0 +1,277 @@
+#pragma once
+#include "RedBlack.h"
+#include <random>		// For Treap priorities
+
+// Balance policies other than Red-Black (default). Each plugs
+// into Tree, Set as 3rd template argument, sharing their Node,
+// iterator and search: Set<int, std::less<int>, WAVLBalance>
+// See RedBlackBalance in RedBlack.h for interface
+namespace RedBlack  {
+
+// Weak AVL (rank-balanced): Node::rank is rank, null's is -1.
+// Rank difference of each child to parent is 1 or 2; leaf has
+// rank 0. Insert-only WAVL is AVL, so height <= 1.44 log(n)
+// https://sidsen.azurewebsites.net/papers/rb-trees-talg.pdf
+struct WAVLBalance {
+	static constexpr bool counted = false;
+
+	template<class Node>
+	static int rankOf(const Node* node) {return node ? int(node->rank) : -1;}
+
+	template<class Tree>
+	static void insert(Tree& tree, typename Tree::Node* x) {
+		using Node = typename Tree::Node;
+		x->rank = 0;
+
+		// x is 0-child of P: break rule, fix up from x
+		Node* P;
+		while ((P = x->parent) && P->rank == x->rank) {
+			Node* S = (x == P->left) ? P->right : P->left;
+
+			// PROMOTE: P was 1,1, so 1 up keeps S's difference
+			// legal. May make P 0-child of its parent: recurse
+			if (rankOf(P) - rankOf(S) == 1) {
+				P->rank++;
+				x = P;
+				continue;
+			}
+
+			// ROTATE (P is 0,2): y is x's child facing S
+			Node* y = (x == P->left) ? x->right : x->left;
+			if (rankOf(x) - rankOf(y) == 2) { // LINE: 1 rotation
+				tree.rotateUp(x);
+				P->rank--;
+			}
+			else {							  // ANGLE: y to top
+				tree.rotateUp(y);
+				tree.rotateUp(y);
+				y->rank++;
+				x->rank--;
+				P->rank--;
+			}
+			break;
+		}
+	}
+
+	template<class Tree>
+	static typename Tree::Node* erase(Tree& tree,
+		typename Tree::Node* node, typename Tree::Node* next) {
+		using Node = typename Tree::Node;
+
+		// 1 child: unary Node has rank 1, so its child is leaf
+		// of rank 0. Splice puts child in node's place: same as
+		// erase of child's leaf, then demote of node to 0
+		Node* P		 = node->parent;
+		bool  isLeft = P && node == P->left;
+		tree.splice(node);
+		if (!P) return next;
+
+		// P left as leaf of rank 1 (2,2 leaf): demote to 0
+		if (!P->left && !P->right && P->rank == 1) {
+			P->rank = 0;
+			Node* child = P;
+			if (!(P = P->parent)) return next;
+			isLeft = child == P->left;
+		}
+
+		// Child of P on isLeft side may be 3-child: fix up
+		while (P) {
+			Node* x = isLeft ? P->left  : P->right;
+			Node* S = isLeft ? P->right : P->left; // Non-null
+			if (rankOf(P) - rankOf(x) != 3) break;
+
+			// DEMOTE P: S is 2-child, so stays legal
+			if (rankOf(P) - rankOf(S) == 2) {
+				P->rank--;
+			}
+			// DOUBLE DEMOTE: S is 1-child with 2,2 childs
+			else if (rankOf(S) - rankOf(S->left ) == 2 &&
+					 rankOf(S) - rankOf(S->right) == 2) {
+				S->rank--;
+				P->rank--;
+			}
+			else {
+				Node* outer = isLeft ? S->right : S->left;
+				Node* inner = isLeft ? S->left  : S->right;
+
+				// LINE: outer is 1-child. S to top
+				if (rankOf(S) - rankOf(outer) == 1) {
+					tree.rotateUp(S);
+					S->rank++;
+					P->rank--;
+					if (!P->left && !P->right) P->rank--; // 2,2 leaf
+				}
+				// ANGLE: inner is 1-child. inner to top
+				else {
+					tree.rotateUp(inner);
+					tree.rotateUp(inner);
+					inner->rank += 2;
+					S->rank--;
+					P->rank -= 2;
+				}
+				break;
+			}
+
+			// Demoted P may now be 3-child of its parent
+			Node* child = P;
+			P = P->parent;
+			isLeft = P && child == P->left;
+		}
+		return next;
+	}
+
+	// Middle-split subtree of size Nodes has height
+	// floor(log2(size)); siblings' heights differ by <= 1
+	template<class Node>
+	static void place(Node* node, size_t, size_t, size_t size) {
+		node->rank = unsigned(std::bit_width(size) - 1);
+	}
+	template<class Tree>
+	static void built(Tree&) {}
+
+	template<class Node>
+	static size_t check(const Node* node, size_t l, size_t r) {
+		if (!l || !r) return 0;
+
+		int lDiff = rankOf(node) - rankOf(node->left );
+		int rDiff = rankOf(node) - rankOf(node->right);
+		if (lDiff < 1 || lDiff > 2 || rDiff < 1 || rDiff > 2) return 0;
+		if (!node->left && !node->right && node->rank != 0) return 0;
+		return 1;
+	}
+	template<class Node>
+	static bool checkRoot(const Node*) {return true;}
+
+	// Insert always fixes at once: never relaxed, nothing pending
+	template<class Tree>
+	static void repair(Tree&, typename Tree::Node*) {}
+
+	template<class Tree>
+	static bool split(Tree&, size_t, Tree&) {return false;}
+	template<class Tree>
+	static bool join (Tree&, Tree&) {return false;}
+};
+
+// Treap: Node::rank is random priority, a max-heap over tree.
+// Expected depth O(log n). Erase splices Node out, no rotate:
+// child has lower priority than Node, so heap holds. Counted,
+// so split, join relink 1 path each: O(log n) expected
+struct TreapBalance {
+	static constexpr bool counted = true;
+
+	static unsigned draw() {
+		thread_local std::minstd_rand rng(std::random_device{}());
+		return unsigned(rng());
+	}
+
+	template<class Tree>
+	static void insert(Tree& tree, typename Tree::Node* added) {
+		added->rank = draw();
+		while (added->parent && added->parent->rank < added->rank) {
+			tree.rotateUp(added);
+		}
+	}
+
+	template<class Tree>
+	static typename Tree::Node* erase(Tree& tree,
+		typename Tree::Node* node, typename Tree::Node* next) {
+		tree.splice(node);
+		return next;
+	}
+
+	template<class Node>
+	static void place(Node*, size_t, size_t, size_t) {}
+
+	// Do: Deal sorted random priorities in level order, so
+	// each parent's is higher than its childs'
+	template<class Tree>
+	static void built(Tree& tree) {
+		using Node = typename Tree::Node;
+		if (!tree.root) return;
+
+		std::vector<Node*> level(1, tree.root);
+		for (size_t i = 0; i < level.size(); i++) {
+			if (level[i]->left ) level.push_back(level[i]->left );
+			if (level[i]->right) level.push_back(level[i]->right);
+		}
+
+		std::vector<unsigned> priority(level.size());
+		for (unsigned& p : priority) p = draw();
+		std::sort(priority.begin(), priority.end(), std::greater<unsigned>());
+		for (size_t i = 0; i < level.size(); i++) level[i]->rank = priority[i];
+	}
+
+	template<class Node>
+	static size_t check(const Node* node, size_t l, size_t r) {
+		if (!l || !r) return 0;
+		if (node->left  && node->left ->rank > node->rank) return 0;
+		if (node->right && node->right->rank > node->rank) return 0;
+		return 1;
+	}
+	template<class Node>
+	static bool checkRoot(const Node*) {return true;}
+
+	// Insert always fixes at once: never relaxed, nothing pending
+	template<class Tree>
+	static void repair(Tree&, typename Tree::Node*) {}
+
+	// Cut of each side along path to n-th Node stays a heap
+	template<class Tree>
+	static bool split(Tree& tree, size_t n, Tree& hi) {
+		auto [lo, up] = cut(tree, tree.root, n);
+		if (lo) lo->parent = nullptr;
+		if (up) up->parent = nullptr;
+		tree.root = lo;
+		hi.root	  = up;
+		return true;
+	}
+
+	template<class Tree>
+	static bool join(Tree& tree, Tree& hi) {
+		tree.root = meld(tree, tree.root, hi.root);
+		if (tree.root) tree.root->parent = nullptr;
+		hi.root = nullptr;
+		return true;
+	}
+
+private:
+	// Helper: Split subtree into its first n Nodes and rest.
+	//		   Re: Their roots; caller sets their parents
+	template<class Tree>
+	static auto cut(Tree& tree, typename Tree::Node* node, size_t n)
+		-> std::pair<typename Tree::Node*, typename Tree::Node*> {
+		if (!node) return {nullptr, nullptr};
+		size_t l = node->left ? node->left->count : 0;
+		if (n <= l) { // Cut is in left subtree: node goes right
+			auto [lo, up] = cut(tree, node->left, n);
+			node->left = up;
+			if (up) up->parent = node;
+			tree.refresh(node);
+			return {lo, node};
+		}
+		auto [lo, up] = cut(tree, node->right, n - l - 1);
+		node->right = lo;
+		if (lo) lo->parent = node;
+		tree.refresh(node);
+		return {node, up};
+	}
+
+	// Helper: Treap of a's keys then b's. Root of higher
+	// priority stays on top; meld below on side facing other
+	template<class Tree>
+	static typename Tree::Node* meld(Tree& tree,
+		typename Tree::Node* a, typename Tree::Node* b) {
+		if (!a || !b) return a ? a : b;
+		if (a->rank > b->rank) {
+			a->right = meld(tree, a->right, b);
+			a->right->parent = a;
+			tree.refresh(a);
+			return a;
+		}
+		b->left = meld(tree, a, b->left);
+		b->left->parent = b;
+		tree.refresh(b);
+		return b;
+	}
+};
+} // namespace RedBlack closed
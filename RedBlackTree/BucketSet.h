@@ -0,0 +1,629 @@
+#pragma once
+#include "RedBlack.h"
+#include <new>			// For placement new into bucket slots
+#include <memory>		// For uninitialized_copy, destroy of slots
+#include <stdexcept>	// For logic_error on use of invalid iterator
+#include <type_traits>	// To pick branchless rank for arithmetic keys
+
+namespace RedBlack  {
+
+// Set whose Tree Nodes each hold a Bucket: up to Cap keys in
+// sorted contiguous slots (default: 2 cache lines of keys).
+// Tree orders Buckets by first key, which each Node keeps a
+// copy of (see Lead): search descends reading Nodes only, in
+// log(n / Cap) loads, then ranks key in 1 Bucket. Full Bucket
+// splits in half; Bucket under Cap / 4 merges with a neighbor
+// if both fit in Cap / 2. Far less memory per key
+//
+// Iterators are std::vector's, not Set's: each is a Node and a
+// slot, so an insert or erase that moves keys (shift in Bucket,
+// split, merge) invalidates all iterators, as do move and swap.
+// Insert or erase at a Bucket's end moves none. Use of an invalid
+// iterator throws: each keeps count of key moves it was made at
+template<class T, class Compare = std::less<T>,
+	class Balance = RedBlackBalance,
+	size_t Cap = (128 / sizeof(T) > 8 ? 128 / sizeof(T) : 8)>
+class BucketSet {
+	static_assert(Cap >= 4, "BucketSet needs Cap >= 4");
+	inline static Compare cmp = Compare();
+
+	// Tree treats Bucket as key: ordered by first(), which may
+	// change in place only while order among Buckets holds, so
+	// slots are mutable through Tree's const access. Node keeps
+	// copy of lead(): Tree::relead after first() changes
+	class Bucket {
+		alignas(T) mutable unsigned char slots[Cap * sizeof(T)];
+	public:
+		mutable size_t n = 0;
+
+		T* at(size_t i) const {return reinterpret_cast<T*>(slots) + i;}
+		const T& first() const {return *at(0);}
+		const T& lead () const {return first();}
+
+		Bucket() {}
+		Bucket(const Bucket& src): n(src.n) {
+			std::uninitialized_copy(src.at(0), src.at(src.n), at(0));
+		}
+		Bucket(Bucket&& src) noexcept: n(src.n) {
+			std::uninitialized_move(src.at(0), src.at(src.n), at(0));
+		}
+		Bucket& operator=(const Bucket&) = delete;
+		~Bucket() {std::destroy(at(0), at(n));}
+
+		bool operator==(const Bucket& o) const {
+			return !cmp(first(), o.first()) && !cmp(o.first(), first());
+		}
+		bool operator!=(const Bucket& o) const {return !(*this == o);}
+
+		// Re: Count of keys < key (orEqual: <= key). Arithmetic
+		//	   keys under std::less: branchless count over all n,
+		//	   which compilers vectorize (SIMD); else binary search
+		size_t rank(const T& key, bool orEqual = false) const;
+
+		// Do: Put key at slot i (keys from i shift up), or erase
+		//	   slot i (keys after shift down)
+		template<class K>
+		void insertAt(size_t i, K&& key) const;
+		void eraseAt (size_t i) const;
+
+		// Do: Move keys from slot i on to end of to
+		void moveTail(size_t i, const Bucket& to) const;
+	};
+
+	struct BucketLess {
+		bool operator()(const Bucket& a, const Bucket& b) const {
+			return cmp(a.first(), b.first());
+		}
+	};
+
+	using Buckets = Tree<Bucket, BucketLess, Balance>;
+	using Node	  = typename Buckets::Node;
+
+	Buckets tree;
+	size_t	sz	  = 0;
+	size_t	moves = 0; // Count of ops that moved keys: see iterator
+
+	// Re: Node of Bucket that holds key if any Bucket does: last
+	//	   whose first() <= key, or first Bucket. Null if empty
+	Node* route(const T& key) const {return tree.findLead(key, cmp);}
+
+public:
+	// For BucketSet, const_iterator and iterator function identically
+	class iterator {
+		friend BucketSet;
+		const BucketSet* set  = nullptr;
+		Node*			 node = nullptr;	// Null: end(), rend()
+		size_t			 i	  = 0;			// Slot in node's Bucket
+		size_t			 seen = 0;			// set->moves when made
+		bool			 isForward = true;
+
+		iterator(const BucketSet* set, Node* node, size_t i,
+			bool isForward = true):
+			set(set), node(node), i(node ? i : 0), seen(set->moves),
+			isForward(isForward) {}
+
+		// Do: Throw if keys moved since iterator was made
+		void check() const {
+			if (seen != set->moves) throw new std::logic_error(
+				"RedBlack::BucketSet iterator used after insert or erase moved keys");
+		}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using difference_type   = std::ptrdiff_t;
+		using value_type        = const T;
+		using reference         = const T&;
+		using pointer           = const T*;
+
+		iterator() {}
+
+		// reverse_iterator's ++() holds predecessor instead of successor
+		bool isReversed() const { return !isForward; }
+
+		bool operator==(const iterator& o) const {
+			assert(isForward == o.isForward &&
+				"Cannot compare iterator[forward] and "
+				"iterator[reversed] types of RedBlack::BucketSet");
+			return node == o.node && i == o.i;
+		}
+		bool operator!=(const iterator& o) const {return !(*this == o);}
+
+		reference operator *() const {
+			check();
+			if (node && i < (**node).n) return *(**node).at(i);
+			throw new std::out_of_range(
+				"Can't dereference out-of-range RedBlack::BucketSet iterator");
+		}
+		pointer   operator->() const {return &(**this);}
+
+		// Re: True if iterator can be dereferenced
+		operator bool() const {return node;}
+
+		// Do: Point iterator to next-higher or next-lower key (--, reversed)
+		iterator& operator++();
+		iterator  operator++(int) {iterator tmp(*this); ++(*this); return tmp;}
+		iterator& operator--();
+		iterator  operator--(int) {iterator tmp(*this); --(*this); return tmp;}
+	};
+
+	iterator begin () const {return iterator(this, tree.min(), 0);}
+	iterator end   () const {return iterator(this, nullptr, 0);}
+	iterator rbegin() const {
+		Node* x = tree.max();
+		return iterator(this, x, x ? (**x).n - 1 : 0, false);
+	}
+	iterator rend  () const {return iterator(this, nullptr, 0, false);}
+
+	using difference_type = iterator::difference_type;
+	using value_compare   = Compare;
+	using key_compare	  = Compare;
+	using pointer		  = T*;
+	using reference		  = T&;
+	using value_type	  = T;
+	using key_type		  = T;
+
+	BucketSet() {}
+	BucketSet(std::initializer_list<T> keys) {insert(keys);}
+	template<typename Iter>
+	BucketSet(Iter it, Iter end) {insert(it, end);}
+
+	//--------------------Modifiers--------------------
+
+	// Re: (1) holds * to key (2) == true if key was not present
+	std::pair<iterator, bool> insert(const T& key) {return put(key);}
+	std::pair<iterator, bool> insert(	  T&& key) {return put((T&&)key);}
+
+	// Re: Same as insert(key). Hint unused
+	iterator insert(iterator, const T& key) {return put(key).first;}
+
+	// Re: Count of inserts of keys not already present
+	template<class Iter>
+	size_t insert(Iter it, Iter end) {
+		size_t added = 0;
+		for (; it != end; it++) added += put(*it).second;
+		return added;
+	}
+	size_t insert(std::initializer_list<T> keys) {
+		return insert(keys.begin(), keys.end());
+	}
+
+	// Re: (1) holds * to key, (2) == True if success
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args&&...args) {
+		return put(T(std::forward<Args>(args)...));
+	}
+
+	// Re: If (2) == true , (1) holds * to key's successor
+	//	   If (2) == false, (1) is end()
+	std::pair<iterator, bool> erase(const T& key);
+
+	// Re: (1) holds its next: successor, or if reversed, predecessor
+	std::pair<iterator, bool> erase(iterator it);
+
+	// Re: Count of keys erased
+	template<class Iter>
+	size_t erase(Iter it, Iter end) {
+		size_t gone = 0;
+		for (; it != end; it++) gone += erase(*it).second;
+		return gone;
+	}
+	size_t erase(std::initializer_list<T> keys) {
+		return erase(keys.begin(), keys.end());
+	}
+	// Range is [*it, *end) in key order. Count first: erase
+	// moves keys, so end would not hold its key after
+	size_t erase(iterator it, iterator end) {
+		size_t count = 0;
+		for (iterator x = it; x != end; ++x) count++;
+		for (size_t i = 0; i < count; i++) it = erase(it).first;
+		return count;
+	}
+
+	// Do: Erase keys where pred(key) (erase_if), or keep only
+	//	   those (retain). 1 pass over Buckets, merging small ones
+	// Re: Count of keys erased
+	template<class Pred>
+	size_t erase_if(Pred pred);
+	template<class Pred>
+	size_t retain  (Pred pred) {
+		return erase_if([&pred](const T& key) {return !pred(key);});
+	}
+
+	friend void swap(BucketSet& a, BucketSet& b) noexcept {
+		swap(a.tree, b.tree);
+		std::swap(a.sz, b.sz);
+		a.moves++; b.moves++;
+	}
+
+	void clear() noexcept {tree.clear(); sz = 0; moves++;}
+
+	//-----------------Priority Queue-----------------
+
+	// Re: Min (front) or max (back) key. Set must not be empty
+	const T& front() const {
+		if (sz) return (**tree.min()).first();
+		throw new std::out_of_range("front() on empty RedBlack::BucketSet");
+	}
+	const T& back () const {
+		if (sz) return *(**tree.max()).at((**tree.max()).n - 1);
+		throw new std::out_of_range("back() on empty RedBlack::BucketSet");
+	}
+
+	// Do: Erase min (front) or max (back) key without search
+	// Re: Erased key, moved out. Set must not be empty
+	T pop_front() {
+		if (!sz) throw new std::out_of_range("pop_front() on empty RedBlack::BucketSet");
+		Node* x = tree.min();
+		T key((T&&)*(**x).at(0));
+		eraseAt(x, 0);
+		return key;
+	}
+	T pop_back () {
+		if (!sz) throw new std::out_of_range("pop_back() on empty RedBlack::BucketSet");
+		Node* x = tree.max();
+		T key((T&&)*(**x).at((**x).n - 1));
+		eraseAt(x, (**x).n - 1);
+		return key;
+	}
+
+	//--------------------Operations--------------------
+
+	// Re: If key is in Set, true. No iterator: no copy of key
+	bool	 count(const T& key) const {
+		Node* x = route(key);
+		if (!x) return false;
+		size_t r = (**x).rank(key);
+		return r < (**x).n && !cmp(key, *(**x).at(r));
+	}
+	bool	 contains(const T& key) const {return count(key);}
+
+	iterator find (const T& key) const {
+		iterator x = lower_bound(key);
+		return x && !cmp(key, *x) ? x : end();
+	}
+	iterator lower_bound(const T& key) const {return bound(key, false);}
+	iterator upper_bound(const T& key) const {return bound(key, true );}
+	std::pair<iterator, iterator>
+		equal_range(const T& key) const {
+		return { lower_bound(key), upper_bound(key) };
+	}
+
+	//--------------------Range Scan--------------------
+
+	// Do: fn(key) on keys in [lo, hi) (or >= lo) in order, up
+	//	   to limit. Within a Bucket, keys are read sequentially
+	// Re: Count of keys visited
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, const T& hi, Fn fn, size_t limit = SIZE_MAX) const {
+		return scanFrom(lo, &hi, fn, limit);
+	}
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, Fn fn, size_t limit = SIZE_MAX) const {
+		return scanFrom(lo, nullptr, fn, limit);
+	}
+
+	// Do: Copy keys in [lo, hi) (or >= lo) in order into out,
+	//	   up to out.size(). Re: Count of keys copied
+	size_t scan(const T& lo, const T& hi, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, hi, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+	size_t scan(const T& lo, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+
+	// Re: View of keys in [lo, hi): bounds found now
+	std::ranges::subrange<iterator> range(const T& lo, const T& hi) const {
+		static_assert(std::ranges::bidirectional_range<
+			std::ranges::subrange<iterator>>);
+		iterator from = lower_bound(lo);
+		if (!cmp(lo, hi)) return {from, from};
+		return {from, lower_bound(hi)};
+	}
+
+	//--------------------Observers--------------------
+
+	size_t size () const noexcept {return sz;}
+	bool   empty() const noexcept {return sz == 0;}
+
+	// Re: Count of Buckets, ie Tree Nodes
+	size_t bucket_count() const {return tree.size();}
+
+	key_compare   key_comp  () const {return Compare();}
+	value_compare value_comp() const {return Compare();}
+
+private:
+	// Re: First key >= key (orEqual: > key)
+	iterator bound(const T& key, bool orEqual) const;
+
+	// Do: Insert key, copied or moved as K is
+	template<class K>
+	std::pair<iterator, bool> put(K&& key);
+
+	// Do: Erase slot r of x's Bucket; merge Bucket if small
+	// Re: Iterator to successor
+	iterator eraseAt(Node* x, size_t r);
+
+	template<class Fn>
+	size_t scanFrom(const T& lo, const T* hi, Fn& fn, size_t limit) const;
+};
+
+template<class T, class Compare, class Balance, size_t Cap>
+size_t BucketSet<T, Compare, Balance, Cap>::Bucket::rank(
+	const T& key, bool orEqual) const {
+	if constexpr (std::is_arithmetic_v<T> &&
+		(std::is_same_v<Compare, std::less<T>> ||
+		 std::is_same_v<Compare, std::less<>>)) {
+		const T* keys = at(0);
+		size_t	 r	  = 0;
+		if (orEqual) for (size_t i = 0; i < n; i++) r += !(key < keys[i]);
+		else		 for (size_t i = 0; i < n; i++) r += keys[i] < key;
+		return r;
+	}
+	else {
+		if (orEqual) return std::upper_bound(at(0), at(n), key, cmp) - at(0);
+		return std::lower_bound(at(0), at(n), key, cmp) - at(0);
+	}
+}
+
+template<class T, class Compare, class Balance, size_t Cap> template<class K>
+void BucketSet<T, Compare, Balance, Cap>::Bucket::insertAt(
+	size_t i, K&& key) const {
+	if (i == n) new (at(n)) T(std::forward<K>(key));
+	else {
+		new (at(n)) T(std::move(*at(n - 1)));
+		std::move_backward(at(i), at(n - 1), at(n));
+		*at(i) = std::forward<K>(key);
+	}
+	n++;
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+void BucketSet<T, Compare, Balance, Cap>::Bucket::eraseAt(size_t i) const {
+	std::move(at(i + 1), at(n), at(i));
+	std::destroy_at(at(--n));
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+void BucketSet<T, Compare, Balance, Cap>::Bucket::moveTail(
+	size_t i, const Bucket& to) const {
+	std::uninitialized_move(at(i), at(n), to.at(to.n));
+	to.n += n - i;
+	std::destroy(at(i), at(n));
+	n = i;
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+typename BucketSet<T, Compare, Balance, Cap>::iterator&
+BucketSet<T, Compare, Balance, Cap>::iterator::operator++() {
+	check();
+	if (!node) {
+		std::string s("Can't increment RedBlack::BucketSet iterator past ");
+		s.append(isForward ? "end()" : "rend()");
+		throw new std::out_of_range(s);
+	}
+	if (isForward) {
+		if (++i == (**node).n) {
+			node = node->inorderNext();
+			i	 = 0;
+		}
+	}
+	else if (i > 0) i--;
+	else {
+		node = node->inorderPrev();
+		i	 = node ? (**node).n - 1 : 0;
+	}
+	return *this;
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+typename BucketSet<T, Compare, Balance, Cap>::iterator&
+BucketSet<T, Compare, Balance, Cap>::iterator::operator--() {
+	check();
+	if (set->empty()) {
+		throw new std::out_of_range(
+			"Can't decrement iterator of empty RedBlack::BucketSet");
+	}
+	Node* to = node;
+	size_t at = i;
+	if (!to) { // end(): to max key. rend(): to min key
+		to = isForward ? set->tree.max() : set->tree.min();
+		at = isForward ? (**to).n - 1 : 0;
+	}
+	else if (isForward) {
+		if (at > 0) at--;
+		else if ((to = to->inorderPrev())) at = (**to).n - 1;
+	}
+	else if (at + 1 < (**to).n) at++;
+	else {
+		to = to->inorderNext();
+		at = 0;
+	}
+
+	if (!to) {
+		std::string s("Can't decrement RedBlack::BucketSet iterator past ");
+		s.append(isForward ? "begin()" : "rbegin()");
+		throw new std::out_of_range(s);
+	}
+	node = to;
+	i	 = at;
+	return *this;
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+typename BucketSet<T, Compare, Balance, Cap>::iterator
+BucketSet<T, Compare, Balance, Cap>::bound(const T& key, bool orEqual) const {
+	Node* x = route(key);
+	if (!x) return end();
+
+	size_t r = (**x).rank(key, orEqual);
+	if (r == (**x).n) return iterator(this, x->inorderNext(), 0);
+	return iterator(this, x, r);
+}
+
+template<class T, class Compare, class Balance, size_t Cap> template<class K>
+std::pair<typename BucketSet<T, Compare, Balance, Cap>::iterator, bool>
+BucketSet<T, Compare, Balance, Cap>::put(K&& key) {
+	Node* x = route(key);
+	if (!x) {
+		Bucket first;
+		first.insertAt(0, std::forward<K>(key));
+		sz = 1;
+		return {iterator(this, tree.insert(first, true).first, 0), true};
+	}
+
+	const Bucket* b = &**x;
+	size_t r = b->rank(key);
+	if (r < b->n && !cmp(key, *b->at(r))) return {iterator(this, x, r), false};
+
+	// SPLIT: Upper half to new Bucket after x. Key goes to half
+	// its rank falls in; upper's first() stays > key if lower
+	if (b->n == Cap) {
+		Bucket upper;
+		b->moveTail(Cap / 2, upper);
+		Node* y = tree.insert(upper, true, x).first;
+		moves++;
+		if (r > Cap / 2) {
+			x = y;
+			b = &**y;
+			r -= Cap / 2;
+		}
+	}
+	if (r < b->n) moves++;
+	b->insertAt(r, std::forward<K>(key));
+	sz++;
+
+	// Only key below all lands at slot 0: of first Bucket
+	if (r == 0) tree.relead(x);
+	return {iterator(this, x, r), true};
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+std::pair<typename BucketSet<T, Compare, Balance, Cap>::iterator, bool>
+BucketSet<T, Compare, Balance, Cap>::erase(const T& key) {
+	Node* x = route(key);
+	if (!x) return {end(), false};
+
+	const Bucket* b = &**x;
+	size_t r = b->rank(key);
+	if (r == b->n || cmp(key, *b->at(r))) return {end(), false};
+	return {eraseAt(x, r), true};
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+std::pair<typename BucketSet<T, Compare, Balance, Cap>::iterator, bool>
+BucketSet<T, Compare, Balance, Cap>::erase(iterator it) {
+	it.check();
+	if (!it) return {it, false};
+	iterator next = eraseAt(it.node, it.i);
+	if (it.isForward) return {next, true};
+
+	// Predecessor: slot before successor's, found after any merge
+	Node*  x  = next.node ? next.node : tree.max();
+	size_t at = next.node ? next.i	  : (x ? (**x).n : 0);
+	if (at > 0) at--;
+	else if (x && (x = x->inorderPrev())) at = (**x).n - 1;
+	return {iterator(this, x, at, false), true};
+}
+
+template<class T, class Compare, class Balance, size_t Cap>
+typename BucketSet<T, Compare, Balance, Cap>::iterator
+BucketSet<T, Compare, Balance, Cap>::eraseAt(Node* x, size_t r) {
+	const Bucket* b = &**x;
+	b->eraseAt(r);
+	sz--;
+	if (r < b->n) moves++;
+	if (r == 0 && b->n) tree.relead(x);
+
+	Node* next = x->inorderNext();
+	Node* prev = x->inorderPrev();
+
+	// Successor: slot r of x, or first of next Bucket
+	Node*  to = r < b->n ? x : next;
+	size_t at = r < b->n ? r : 0;
+	if (b->n >= Cap / 4) return iterator(this, to, at);
+
+	// Erase empty Bucket; else MERGE small one with neighbor.
+	// Merged Bucket keeps lower's first(): order holds. Merge
+	// moves keys out of 1 Bucket and frees its Node; successor
+	// moves with its key
+	if		(b->n == 0) tree.eraseNode(x);
+	else if (next && b->n + (**next).n <= Cap / 2) {
+		if (to == next) {
+			to = x;
+			at = b->n;
+		}
+		(**next).moveTail(0, *b);
+		tree.eraseNode(next);
+		moves++;
+	}
+	else if (prev && b->n + (**prev).n <= Cap / 2) {
+		if (to == x) {
+			to = prev;
+			at = (**prev).n + r;
+		}
+		b->moveTail(0, **prev);
+		tree.eraseNode(x);
+		moves++;
+	}
+	return iterator(this, to, at);
+}
+
+template<class T, class Compare, class Balance, size_t Cap> template<class Pred>
+size_t BucketSet<T, Compare, Balance, Cap>::erase_if(Pred pred) {
+	size_t gone = 0;
+	Node*  prev = nullptr; // Last Bucket kept
+	for (Node* x = tree.min(); x; ) {
+		const Bucket& b = **x;
+		T* last = std::remove_if(b.at(0), b.at(b.n), pred);
+		size_t k = b.at(b.n) - last;
+		std::destroy(last, b.at(b.n));
+		b.n	 -= k;
+		gone += k;
+
+		if (b.n == 0) {
+			x = tree.eraseNode(x);
+			continue;
+		}
+		if (k) tree.relead(x);
+
+		// Small Bucket joins kept one before it, if both fit
+		if (prev && (b.n < Cap / 4 || (**prev).n < Cap / 4) &&
+			b.n + (**prev).n <= Cap / 2) {
+			b.moveTail(0, **prev);
+			x = tree.eraseNode(x);
+			continue;
+		}
+		prev = x;
+		x	 = x->inorderNext();
+	}
+	sz -= gone;
+	if (gone) moves++;
+	return gone;
+}
+
+template<class T, class Compare, class Balance, size_t Cap> template<class Fn>
+size_t BucketSet<T, Compare, Balance, Cap>::scanFrom(
+	const T& lo, const T* hi, Fn& fn, size_t limit) const {
+	Node* x = route(lo);
+	if (!x) return 0;
+	size_t from = (**x).rank(lo);
+
+	size_t count = 0;
+	while (x) {
+		// Load next Bucket while this one is read
+		Node* next = x->inorderNext();
+		if (next) REDBLACK_PREFETCH(&**next);
+
+		const Bucket& b = **x;
+		for (size_t at = from; at < b.n; at++) {
+			if (count == limit || (hi && !cmp(*b.at(at), *hi))) return count;
+			fn(*b.at(at));
+			count++;
+		}
+		x	 = next;
+		from = 0;
+	}
+	return count;
+}
+} // namespace RedBlack closed
@@ -0,0 +1,243 @@
+#pragma once
+#include "RedBlack.h"
+#include <type_traits>	// For coordinate types X, Y of T
+#include <iterator>		// For back_inserter to merge levels
+
+namespace RedBlack  {
+
+// Default coordinates: T has members x, y, as Point does
+template<class T> struct XOf {auto operator()(const T& p) const {return p.x;}};
+template<class T> struct YOf {auto operator()(const T& p) const {return p.y;}};
+
+// Set of 2D keys answering "all in [x1, x2] x [y1, y2]" in
+// O(log^3 n + k), not a scan of every key in [x1, x2]
+//
+// Static range tree: keys sorted by x. Each node of implicit
+// balanced tree over that order keeps its keys sorted by y,
+// so query is O(log n) nodes, each a binary search on y
+//
+// Dynamic by logarithmic method: levels[i] is a static range
+// tree of 0 or 2^i keys. Insert merges full levels as binary
+// counter carries: O(log^2 n) amortized. Erase marks key in
+// dead, skipped by query; once dead outnumber live, rebuild
+//
+// Not a RedBlack::Tree over x with a y-structure per Node: a
+// rotation changes the key set of 2 subtrees, so it rebuilds
+// their y-structures in O(size). Rotation near root costs O(n)
+// and Red-Black makes no promise where rotations fall, so an
+// insert is O(n) at worst. Static levels are rebuilt only as
+// a whole, on carry. Tree (Set) holds live and dead keys, for
+// count, dedupe and erase in O(log n)
+template<class T, class Compare = std::less<T>,
+	class GetX = XOf<T>, class GetY = YOf<T>>
+class RangeTree {
+public:
+	using X = std::decay_t<std::invoke_result_t<GetX, const T&>>;
+	using Y = std::decay_t<std::invoke_result_t<GetY, const T&>>;
+
+private:
+	struct Level {
+		std::vector<T> byX;
+
+		// byY[d][lo, hi): keys of node at depth d over byX[lo, hi),
+		// sorted by y. Nodes of a depth tile [0, size)
+		std::vector<std::vector<T>> byY;
+
+		// Do: Build byY over byX, which must be sorted by x
+		void build(size_t depth, size_t lo, size_t hi);
+
+		// Do: fn(key) on keys of byX[a, b) with y in [y1, y2]
+		template<class Fn>
+		void query(size_t depth, size_t lo, size_t hi, size_t a, size_t b,
+			const Y& y1, const Y& y2, Fn& fn) const;
+	};
+
+	std::vector<Level> levels;
+	Set<T, Compare>	   live; // Keys in RangeTree
+	Set<T, Compare>	   dead; // Keys in levels, but erased
+	inline static GetX xOf = GetX();
+	inline static GetY yOf = GetY();
+
+	static bool xLess(const T& a, const T& b) {return xOf(a) < xOf(b);}
+	static bool yLess(const T& a, const T& b) {return yOf(a) < yOf(b);}
+
+	// Do: Make level i a static range tree over keys
+	void place(size_t i, std::vector<T>&& keys);
+
+	// Do: Rebuild levels from live keys only. Clear dead
+	void rebuild();
+
+public:
+	RangeTree() = default;
+
+	template<typename Iter>
+	RangeTree(Iter it, Iter end) {
+		for (; it != end; it++) live.insert(*it);
+		rebuild();
+	}
+
+	//--------------------Modifiers--------------------
+
+	// Re: true if key was not already present
+	bool insert(const T& key);
+
+	// Re: true if key was found
+	bool erase (const T& key);
+
+	void clear() {levels.clear(); live.clear(); dead.clear();}
+
+	//--------------------Operations--------------------
+
+	bool count(const T& key) const {return live.count(key);}
+
+	// Do: Call fn(key) on each key in [x1, x2] x [y1, y2], in
+	//	   no set order. Re: Count of keys reported
+	template<class Fn>
+	size_t query(const X& x1, const X& x2, const Y& y1, const Y& y2,
+		Fn fn) const;
+
+	// Re: Keys in [x1, x2] x [y1, y2], in no set order
+	std::vector<T> query(const X& x1, const X& x2,
+		const Y& y1, const Y& y2) const {
+		std::vector<T> out;
+		query(x1, x2, y1, y2, [&out](const T& key) {out.push_back(key);});
+		return out;
+	}
+
+	//--------------------Observers--------------------
+
+	size_t size () const {return live.size();}
+	bool   empty() const {return live.empty();}
+
+	// Re: Live keys in Compare order
+	const Set<T, Compare>& keys() const {return live;}
+};
+
+// Split at mid as Tree::build does: children halve [lo, hi)
+template<class T, class Compare, class GetX, class GetY>
+void RangeTree<T, Compare, GetX, GetY>::Level::build(
+	size_t depth, size_t lo, size_t hi) {
+	if (hi - lo == 1) {
+		byY[depth][lo] = byX[lo];
+		return;
+	}
+	size_t mid = lo + (hi - lo) / 2;
+	build(depth + 1, lo, mid);
+	build(depth + 1, mid, hi);
+	std::merge(byY[depth + 1].begin() + lo,  byY[depth + 1].begin() + mid,
+			   byY[depth + 1].begin() + mid, byY[depth + 1].begin() + hi,
+			   byY[depth].begin() + lo, yLess);
+}
+
+// Node inside [a, b): its y-sorted run answers whole node.
+// Node partly inside: recurse. O(log n) whole nodes at most
+template<class T, class Compare, class GetX, class GetY> template<class Fn>
+void RangeTree<T, Compare, GetX, GetY>::Level::query(
+	size_t depth, size_t lo, size_t hi, size_t a, size_t b,
+	const Y& y1, const Y& y2, Fn& fn) const {
+	if (b <= lo || hi <= a) return;
+
+	if (a <= lo && hi <= b) {
+		auto it  = byY[depth].begin() + lo;
+		auto end = byY[depth].begin() + hi;
+		it = std::partition_point(it, end,
+			[&y1](const T& key) {return yOf(key) < y1;});
+		for (; it != end && !(y2 < yOf(*it)); it++) fn(*it);
+		return;
+	}
+	size_t mid = lo + (hi - lo) / 2;
+	query(depth + 1, lo, mid, a, b, y1, y2, fn);
+	query(depth + 1, mid, hi, a, b, y1, y2, fn);
+}
+
+template<class T, class Compare, class GetX, class GetY>
+void RangeTree<T, Compare, GetX, GetY>::place(size_t i, std::vector<T>&& keys) {
+	if (i >= levels.size()) levels.resize(i + 1);
+	Level& level = levels[i];
+	level.byX = std::move(keys);
+
+	// Depths: 1 per halving until runs of 1 key
+	size_t depths = std::bit_width(level.byX.size() - 1) + 1;
+	level.byY.assign(depths, level.byX); // Copy, as T may lack T()
+	level.build(0, 0, level.byX.size());
+}
+
+template<class T, class Compare, class GetX, class GetY>
+void RangeTree<T, Compare, GetX, GetY>::rebuild() {
+	std::vector<T> keys(live.begin(), live.end());
+	std::stable_sort(keys.begin(), keys.end(), xLess);
+	levels.clear();
+	dead.clear();
+
+	// Size's binary digits give levels: carve runs of 2^i keys,
+	// each sorted by x as keys are
+	size_t at = 0;
+	for (size_t i = std::bit_width(keys.size()); i-- > 0; ) {
+		if (!(keys.size() >> i & 1)) continue;
+		place(i, std::vector<T>(keys.begin() + at, keys.begin() + at + (size_t(1) << i)));
+		at += size_t(1) << i;
+	}
+}
+
+template<class T, class Compare, class GetX, class GetY>
+bool RangeTree<T, Compare, GetX, GetY>::insert(const T& key) {
+	if (!live.insert(key).second) return false;
+
+	// Erased key is still in a level: revive it
+	if (dead.count(key)) {
+		dead.erase(key);
+		return true;
+	}
+
+	// Carry: merge full levels 0, 1, .. into first empty one
+	std::vector<T> carry(1, key);
+	size_t i = 0;
+	for (; i < levels.size() && !levels[i].byX.empty(); i++) {
+		std::vector<T> merged;
+		merged.reserve(carry.size() + levels[i].byX.size());
+		std::merge(carry.begin(), carry.end(),
+			levels[i].byX.begin(), levels[i].byX.end(),
+			std::back_inserter(merged), xLess);
+		carry.swap(merged);
+		levels[i] = Level();
+	}
+	place(i, std::move(carry));
+	return true;
+}
+
+template<class T, class Compare, class GetX, class GetY>
+bool RangeTree<T, Compare, GetX, GetY>::erase(const T& key) {
+	if (!live.erase(key).second) return false;
+	dead.insert(key);
+
+	// Dead keys cost query time and memory: drop once they
+	// are half of keys held
+	if (dead.size() > live.size()) rebuild();
+	return true;
+}
+
+template<class T, class Compare, class GetX, class GetY> template<class Fn>
+size_t RangeTree<T, Compare, GetX, GetY>::query(
+	const X& x1, const X& x2, const Y& y1, const Y& y2, Fn fn) const {
+	size_t reported = 0;
+	bool   anyDead	= !dead.empty();
+	auto report = [&](const T& key) {
+		if (anyDead && dead.count(key)) return;
+		fn(key);
+		reported++;
+	};
+
+	for (const Level& level : levels) {
+		if (level.byX.empty()) continue;
+
+		// [a, b): keys of level with x in [x1, x2]
+		const std::vector<T>& byX = level.byX;
+		size_t a = std::partition_point(byX.begin(), byX.end(),
+			[&x1](const T& key) {return xOf(key) < x1;}) - byX.begin();
+		size_t b = std::partition_point(byX.begin() + a, byX.end(),
+			[&x2](const T& key) {return !(x2 < xOf(key));}) - byX.begin();
+		if (a < b) level.query(0, 0, byX.size(), a, b, y1, y2, report);
+	}
+	return reported;
+}
+} // namespace RedBlack closed
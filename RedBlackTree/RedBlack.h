@@ -1,9 +1,35 @@
 #pragma once
 #include <stack>		// For traversal on Tree's copy constructor
+#include <deque>		// For violations pending in relaxed mode
+#include <vector>		// For staging buffer and bulk build
+#include <algorithm>	// For sort of staging buffer on flush
+#include <bit>			// For bit_width to pick flush strategy
+#include <thread>		// For parallel bulk build and traversal
+#include <atomic>		// For workers to claim traversal tasks
+#include <type_traits>	// For decay_t of Node's copy of key's lead
+#include <optional>		// For per-task partial of parallel reduce
+#include <memory>		// For allocator of relayout's Node blocks
+#include <new>			// For placement new into Node blocks
+#include <cmath>		// For log2 of layout distances
 #include <cstddef>		// To access to ptrdiff_t for Set's alias
+#include <cstdint>		// For uint64_t of Digest
+#include <functional>	// For std::hash of keys in Digest
+#include <span>			// For scan() into caller's buffer
+#include <ranges>		// For range() view over iterator
 #include <stdexcept>
 #include <cassert>
 
+// Hint CPU to load *p into cache before it is read. No-op
+// if compiler has no prefetch
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define REDBLACK_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define REDBLACK_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define REDBLACK_PREFETCH(p) ((void)0)
+#endif
+
 namespace RedBlack  {
 // NOTE: To test. Set<Point, Point::CMP> s; #include <iostream>
 //struct Point {
@@ -26,31 +52,275 @@ namespace RedBlack  {
 //	};
 //};
 
-template<class T, class Compare = std::less<T>> class Set;
+// Balance policy: keeps Tree shallow on insert, erase. Tree
+// owns Nodes, search and iteration; Balance owns only shape
+// and Node's isRed, rank fields. Interface of a Balance:
+//	insert(tree, node): node is new leaf, already linked
+//	erase (tree, node, next): Unlink node (<= 1 child) from tree,
+//		 not delete: Tree frees or reuses it. Re: next. Relink
+//		 Nodes only, never move keys
+//		 between them: other Nodes' iterators must stay valid
+//	place (node, depth, redDepth, size): Set fields of Node built
+//		 at depth, root of size Nodes (see Tree::build)
+//	built (tree):	   After build, for fields not set by place
+//	check (node, l, r): node's rule, given l, r from its childs'
+//		 check. Re: 0 if broken. Null child's check is 1
+//	checkRoot(root):	Rule for root only
+//	repair(tree, node): Fix violation insert left at node in
+//		 relaxed mode (see Tree::setRelaxed). No-op if none
+//	counted: If true, Node::count holds Nodes in its subtree
+//	split(tree, n, hi): Move keys past first n to empty hi by
+//		 relinking. join(tree, hi): Link hi's keys, all greater,
+//		 into tree. Re: false if policy can't; Tree rebuilds
+// See Balance.h for WAVL and Treap
+struct RedBlackBalance {
+	static constexpr bool counted = false;
+
+	template<class Tree>
+	static void insert(Tree& tree, typename Tree::Node* added);
+	template<class Tree>
+	static typename Tree::Node* erase(Tree& tree,
+		typename Tree::Node* node, typename Tree::Node* next);
+
+	// Levels above redDepth are full; color partial one red
+	template<class Node>
+	static void place(Node* node, size_t depth, size_t redDepth, size_t) {
+		node->isRed = depth == redDepth;
+	}
+	template<class Tree>
+	static void built(Tree&) {}
+
+	// Re: Black depth, or 0 if red rule or black depth broken
+	template<class Node>
+	static size_t check(const Node* node, size_t lDepth, size_t rDepth) {
+		if (node->isRed && ((node->left  && node->left ->isRed) ||
+							(node->right && node->right->isRed))) {
+			return 0;
+		}
+		if (!lDepth || lDepth != rDepth) return 0;
+		return lDepth + !node->isRed;
+	}
+	template<class Node>
+	static bool checkRoot(const Node* root) {return !root->isRed;}
+
+	template<class Tree>
+	static void repair(Tree& tree, typename Tree::Node* node);
+
+	template<class Tree>
+	static bool split(Tree&, size_t, Tree&) {return false;}
+	template<class Tree>
+	static bool join (Tree&, Tree&) {return false;}
+
+private:
+	// Helper: Restore rule that red Node has black || null childs
+	template<class Tree>
+	static void balanceInsert(Tree& tree, typename Tree::Node* current);
+
+	// Helper: If trim black depth of any branch, trim all other
+	template<class Tree>
+	static void balanceErase (Tree& tree, typename Tree::Node* toErase);
+};
+
+// Merkle summary of Node's subtree, kept only if Tree is Hashed
+// Polynomial hash over inorder keys: sum of h(key_i) * B^i, so
+// it depends on keys and order, not on shape. Equal sets have
+// equal hash whatever their rotations. Arithmetic is mod 2^64
+template<bool Hashed> struct Digest {};
+template<> struct Digest<true> {
+	size_t	 count = 1; // Nodes in subtree
+	uint64_t hash  = 0; // Sum of h(key_i) * B^i, i from 0 inorder
+	uint64_t pw	   = B; // B^count, to shift hash of keys after
+
+	// Odd, so B^i is invertible: hash of range can be shifted
+	static constexpr uint64_t B = 0x9E3779B97F4A7C15ull;
+
+	// Do: Concatenate r's keys after *this's
+	void append(const Digest& r) {
+		hash  += pw * r.hash;
+		pw	  *= r.pw;
+		count += r.count;
+	}
+
+	// Re: h(key): std::hash spread over all 64 bits (splitmix64)
+	static uint64_t mix(uint64_t x) {
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	// Re: x^-1 mod 2^64 by Newton: each step doubles bits right
+	static uint64_t inverse(uint64_t x) {
+		uint64_t inv = x; // x * x == 1 mod 8: 3 bits right
+		for (int i = 0; i < 5; i++) inv *= 2 - x * inv;
+		return inv;
+	}
+};
+
+// Nodes in subtree, kept if Balance::counted and not Hashed
+// (Digest keeps its own). Set by Tree::refresh, as Digest is
+template<bool Counted> struct Count {};
+template<> struct Count<true> {size_t count = 1;};
+
+// If T has lead() (as BucketSet's Bucket: its first key), Node
+// keeps a copy, so descent by lead reads Nodes, not keys
+template<class T> struct Lead {void relead(const T*) {}};
+template<class T> requires requires(const T& key) {key.lead();}
+struct Lead<T> {
+	std::decay_t<decltype(std::declval<const T&>().lead())> lead;
+	void relead(const T* key) {lead = key->lead();}
+};
+
+// Hash table from key to Node holding it, kept beside Tree for
+// O(1) find, count, erase by key; ordered ops still use Tree
+// Open addressing, linear probe. tags[i] is 1 byte per slot:
+// 0 empty, 1 erased, else 0x80 | top 7 bits of hash. A probe
+// reads tags first, so a miss seldom touches slots or keys:
+// tags act as compact filter for absent keys. Slot keeps T*,
+// which stays with its key; only relayout moves Nodes: relink
+template<class T, class Node>
+class KeyIndex {
+public:
+	using Hasher = uint64_t (*)(const T&);
+
+private:
+	struct Slot {const T* key; Node* node;};
+	std::vector<uint8_t> tags;
+	std::vector<Slot>	 slots;
+	size_t used = 0; // Live entries
+	size_t dead = 0; // Erased slots (tag 1), until rehash
+	Hasher hasher;
+
+	static uint8_t tagOf(uint64_t h) {return uint8_t(0x80 | (h >> 57));}
+
+	// Re: Index of slot holding key pointer, or SIZE_MAX
+	size_t slotOf(const T* key) const {
+		if (tags.empty()) return SIZE_MAX;
+		uint64_t h = hasher(*key);
+		size_t	 mask = tags.size() - 1;
+		for (size_t i = h & mask; tags[i]; i = (i + 1) & mask) {
+			if (tags[i] > 1 && slots[i].key == key) return i;
+		}
+		return SIZE_MAX;
+	}
+
+	// Do: Resize to fit 2 * used entries, drop erased slots
+	void rehash() {
+		size_t cap = std::bit_ceil(std::max<size_t>(16, 2 * used + 2));
+		std::vector<uint8_t> oldTags (cap, 0); // Swapped: old table
+		std::vector<Slot>	 oldSlots(cap);
+		oldTags .swap(tags);
+		oldSlots.swap(slots);
+		used = dead = 0;
+		for (size_t i = 0; i < oldTags.size(); i++) {
+			if (oldTags[i] > 1) add(oldSlots[i].key, oldSlots[i].node);
+		}
+	}
+
+public:
+	explicit KeyIndex(Hasher hasher): hasher(hasher) {}
+
+	Hasher hashOf() const {return hasher;}
+
+	// Re: Node holding key, or null
+	Node* find(const T& key) const {
+		if (tags.empty()) return nullptr;
+		uint64_t h	 = hasher(key);
+		uint8_t	 tag = tagOf(h);
+		size_t	 mask = tags.size() - 1;
+		for (size_t i = h & mask; tags[i]; i = (i + 1) & mask) {
+			if (tags[i] == tag && *slots[i].key == key) return slots[i].node;
+		}
+		return nullptr;
+	}
+
+	// Do: Map key, which must be absent, to node
+	void add(const T* key, Node* node) {
+		if ((used + dead + 1) * 8 > tags.size() * 7) rehash();
+		uint64_t h	  = hasher(*key);
+		size_t	 mask = tags.size() - 1;
+		size_t	 i	  = h & mask;
+		for (; tags[i] > 1; i = (i + 1) & mask) {}
+		dead -= tags[i] == 1;
+		tags [i] = tagOf(h);
+		slots[i] = {key, node};
+		used++;
+	}
+
+	// Do: Unmap key (by pointer; *key still holds its value)
+	void remove(const T* key) {
+		size_t i = slotOf(key);
+		if (i == SIZE_MAX) return;
+		tags[i] = 1;
+		used--; dead++;
+	}
+
+	// Do: key's Node moved to node (relayout). No-op if unmapped
+	void relink(const T* key, Node* node) {
+		size_t i = slotOf(key);
+		if (i != SIZE_MAX) slots[i].node = node;
+	}
+
+	void clear() {
+		tags.assign(tags.size(), 0);
+		used = dead = 0;
+	}
+
+	// Re: Heap bytes held, for cost of index per Set
+	size_t bytes() const {
+		return sizeof(*this) + tags.capacity() + slots.capacity() * sizeof(Slot);
+	}
+};
+
+// Order of Nodes in memory after Tree::relayout
+//	Preorder: Node, then left, then right subtree
+//	VEB:	  van Emde Boas: top half of levels, then each
+//			  subtree below, recursively. Any path crosses
+//			  few cache lines, whatever their size
+enum class Layout {Preorder, VEB};
+
+// If Hashed, each Node keeps Digest of its subtree: == rejects
+// unequal Sets in O(1), diff() skips key ranges that match
+template<class T, class Compare = std::less<T>,
+	class Balance = RedBlackBalance, bool Hashed = false> class Set;
 
 // T must overload == and !=. Sample for Compare:
 // struct CMP {bool operator () (const T& a, const T& b) const {..}};
-template<class T, class Compare>
+// If Hashed, std::hash<T> must exist
+template<class T, class Compare, class Balance, bool Hashed = false>
 struct Tree {
-	class Node {
-		friend Tree<T, Compare>;
-		// Store * to swap between Nodes without copying
-		T*	 key;
-		bool isRed; // Use to balance tree
+	using Counter = Count<Balance::counted && !Hashed>;
+
+	class Node: Digest<Hashed>, Counter, Lead<T> {
+		friend Tree<T, Compare, Balance, Hashed>;
+		friend Balance;
+		// Store * to hand to new Node without copying. Key stays
+		// in its Node till erased: iterators are Node handles
+		T*		 key;
+		bool	 isRed;	   // Use to balance tree (Red-Black)
+		bool	 inArena = false; // In block of relayout(), not new
+		unsigned rank = 0; // Use to balance tree (other Balance)
 		Node *parent, *left = nullptr, *right = nullptr;
 
-		void  swapKey(T*& e) noexcept { // Swap contents
-			T* tmp = key; key = e; e = tmp;
+		// Copy src's fields kept by Balance and Digest, not links
+		void  copyAux(const Node* src) {
+			isRed = src->isRed;
+			rank  = src->rank;
+			static_cast<Digest<Hashed>&>(*this) = *src;
+			static_cast<Counter&>(*this) = *src;
 		}
 
+		// Bulk build: adopt already allocated key without copy
+		Node(T* key, bool isRed, Node* parent):
+			key(key), isRed(isRed), parent(parent) {this->relead(key);}
+
 	public:
 		// ie insert(Iter, Iter) calls insert(key) calls Node(const T&..)
 		Node(const T& v, bool isRed = true, Node* parent = nullptr):
-			key(new T(v)), isRed(isRed), parent(parent) {}
+			key(new T(v)), isRed(isRed), parent(parent) {this->relead(key);}
 
-		// ie insert(init_list) calls  insert(key) calls Node(      T&&..)
+		// ie insert(T&&) calls insert(key) calls Node(		T&&..)
 		Node(	  T&& v, bool isRed = true, Node* parent = nullptr):
-			key(new T(v)), isRed(isRed), parent(parent) {}
+			key(new T((T&&)v)), isRed(isRed), parent(parent) {this->relead(key);}
 
 		const T& operator *() const {return *key;}
 
@@ -60,14 +330,21 @@ struct Tree {
 		Node* inorderNext();
 		Node* inorderPrev();
 
-		~Node() {delete key; delete left; delete right;}
+		// Childs are not deleted: Tree::destroy frees subtrees
+		~Node() {delete key;}
 	};
 
 	Tree(): root(nullptr), sz(0) {}
 
 	// Insert as root: black Node holding key. Root is always black
-	Tree(const T& key): root(new Node(	   key, false)), sz(1) {}
-	Tree(	  T&& key): root(new Node((T&&)key, false)), sz(1) {}
+	Tree(const T& key): root(new Node(	   key, false)), sz(1) {
+		first = last = root;
+		refresh(root);
+	}
+	Tree(	  T&& key): root(new Node((T&&)key, false)), sz(1) {
+		first = last = root;
+		refresh(root);
+	}
 
 	template<typename Iter>
 	Tree(Iter it, Iter end): Tree() {insert(it, end);}
@@ -82,6 +359,19 @@ struct Tree {
 			Tree  cpy(src);
 			Node* ptr = root; root = cpy.root; cpy.root = ptr;
 			sz		  = src.sz;
+			pending.swap(cpy.pending);
+			arenas .swap(cpy.arenas ); // Copy frees OG's Nodes
+			std::swap(index, cpy.index);
+			setLayoutFrom(nullptr);
+			first	  = cpy.first;
+			last	  = cpy.last;
+			staged	  = src.staged;
+			stagedSorted = src.stagedSorted;
+			net		  = src.net.load();
+			netKnown  = src.netKnown.load();
+			stageMax  = src.stageMax;
+			relaxed	  = src.relaxed;
+			relaxStep = src.relaxStep;
 		}
 		return *this;
 	}
@@ -98,30 +388,85 @@ struct Tree {
 	friend void swap(Tree& a, Tree& b) noexcept {
 		Node*  tRoot = a.root; a.root = b.root; b.root = tRoot;
 		size_t tSz	 = a.sz  ; a.sz   = b.sz  ; b.sz   = tSz;
+		std::swap(a.first, b.first);
+		std::swap(a.last , b.last );
+		a.staged.swap(b.staged);
+		std::swap(a.stagedSorted, b.stagedSorted);
+		a.net	   = b.net.exchange(a.net);
+		a.netKnown = b.netKnown.exchange(a.netKnown);
+		std::swap(a.stageMax, b.stageMax);
+		a.pending.swap(b.pending);
+		std::swap(a.relaxed  , b.relaxed  );
+		std::swap(a.relaxStep, b.relaxStep);
+		a.arenas.swap(b.arenas);
+		std::swap(a.index, b.index);
+		std::swap(a.layoutFrom, b.layoutFrom);
 	}
 
-	void clear() noexcept {delete root; root = nullptr; sz = 0;}
-	~Tree() {delete root;}
+	void clear() noexcept {
+		destroy(root); root = first = last = nullptr;
+		sz = 0; staged.clear(); stagedSorted = 0;
+		net = 0; netKnown = false;
+		pending.clear(); setLayoutFrom(nullptr);
+		if (index) index->clear();
+	}
+	~Tree() {destroy(root); delete layoutFrom; delete index;}
 
 	// Trees to match keys, not Node* or tree structure
-	bool operator==(const Tree& o);
-	bool operator!=(const Tree& o) {return !(*this == o);}
+	// If Hashed, unequal digests reject in O(1)
+	bool operator==(const Tree& o) const;
+	bool operator!=(const Tree& o) const {return !(*this == o);}
+
+	//--------------------Digest--------------------
+	// Only if Hashed. Kept on insert, erase and rotate at cost
+	// of O(log n) hash combines per op
+
+	// Re: Hash of all keys in order; 0 if empty. Trees holding
+	//	   same keys have same digest, whatever their shape
+	uint64_t digest() const;
+
+	// Re: Keys in exactly 1 of *this, o, ascending. Compare
+	//	   digests of key ranges; descend only into unequal
+	//	   ones: ~O(d log^2 n) for d differences, not O(n)
+	std::vector<T> diff(const Tree& o) const;
 
 	bool less(const T& a, const T& b) const {
 		return cmp(a, b);
 	}
 
-	Node*  min () const; // Re: Node having min key by Compare
-	Node*  max () const; // Re: Node having max key by Compare
+	// Re: true if neither key is less: keys match by Compare,
+	//	   not T's ==, in search, insert and staged ops alike
+	static bool same(const T& a, const T& b) {
+		return !cmp(a, b) && !cmp(b, a);
+	}
+
+	// O(1): ends are cached, kept on insert and erase
+	Node*  min () const {return first;} // Re: Node having min key
+	Node*  max () const {return last ;} // Re: Node having max key
 	size_t size() const {return sz;}
 
 	//------------------Implementation------------------
 	// If didn't find exact key && !getClosest, return null
 	Node*  find(const T& key, bool getClosest = true) const;
 
+	// Same as find(), but climb from finger only as far as
+	// needed, then descend: cost grows with log of distance
+	// in key order from finger's key. Null finger: from root
+	Node*  findFrom(Node* finger, const T& key, bool getClosest = true) const;
+
+	// Only if T has lead(). Re: Node of last key whose lead is
+	//	   not above key (by less), else min(). Reads no key
+	template<class K, class Less>
+	Node*  findLead(const K& key, Less less) const;
+
+	// Do: Copy lead() of node's key, after key changed in place
+	void   relead(Node* node) {node->relead(node->key);}
+
 	// Pair: (1) Holds target key	   (2) true if success
 	// If toMove, move construct T for Node::key; else copy construct
-	std::pair<Node*, bool> insert(const T& key, bool toMove = false);
+	// If hint, search from it as findFrom() does
+	std::pair<Node*, bool> insert(const T& key, bool toMove = false,
+		Node* hint = nullptr);
 
 	// Re: Count of inserts of keys not already present
 	template<typename Iter>
@@ -129,8 +474,8 @@ struct Tree {
 	size_t insert(std::initializer_list<T> keys);
 
 	// Specialize: To iterate over and erase from tree at same time
-	size_t erase(
-		Set<T, Compare>::iterator it, Set<T, Compare>::iterator end);
+	size_t erase(Set<T, Compare, Balance, Hashed>::iterator it,
+		Set<T, Compare, Balance, Hashed>::iterator end);
 
 	// Re: Count of erases of keys found
 	template<typename Iter>
@@ -140,39 +485,411 @@ struct Tree {
 	// Pair: (1) Holds successor key	(2) true if key found
 	std::pair<Node*, bool> erase(const T& key);
 
+	// Re: Node holding successor key. No search: node is known
+	//	   Other Nodes keep own keys, so stay valid
+	//	   inIndex: false if caller took node out of index already
+	Node*  eraseNode(Node* node, bool inIndex = true);
+
+	// Do: Erase keys for which pred(key) == true. 1 in-order
+	//	   pass finds them; if few, erase each, O(k log n); if
+	//	   many, relink Nodes left into balanced Tree, O(n)
+	// Re: Count of keys erased
+	template<class Pred>
+	size_t eraseIf(Pred pred);
+
+	// Do: Erase Node holding min (isMax: max) key, no search
+	// Re: Its key, moved out. Tree must not be empty
+	T	   popEnd(bool isMax);
+
+	// Do: Set node's key to key. In place if order holds with
+	//	   neighbors; else unlink node, relink it where key
+	//	   belongs. No Node, key is freed or made: node stays valid
+	// Pair: (1) Holds key	(2) false if key held by other Node
+	std::pair<Node*, bool> updateKey(Node* node, const T& key,
+		bool toMove = false);
+
+	//------------------Staging Buffer------------------
+	// Deferred insert (toInsert) or erase of key. Flush once
+	// buffer holds stageMax ops. find(), size() ignore buffer
+	// Once stagedNet() is asked, finds if key is held now, to
+	// keep it known: bursts that never ask size() skip find
+	void stage(const T& key, bool toInsert);
+	void stage(		 T&& key, bool toInsert);
+
+	// Re: 1 if last staged op on key is insert, -1 if erase,
+	//	   0 if key is not staged. Newest op wins. Scans ops
+	//	   staged since last sort, then binary searches rest:
+	//	   O(sqrt n + log n), as stage() sorts in long tail.
+	//	   Reads only: safe from concurrent readers
+	int  stagedOp(const T& key) const;
+
+	bool hasStaged() const {return !staged.empty();}
+
+	// Re: Change in size() flush will make. If not known, find
+	//	   each staged key once; concurrent callers agree on it
+	ptrdiff_t stagedNet() const {
+		if (!netKnown.load(std::memory_order_acquire)) {
+			net.store(countNet(), std::memory_order_relaxed);
+			netKnown.store(true, std::memory_order_release);
+		}
+		return net.load(std::memory_order_relaxed);
+	}
+	void setStageMax(size_t n) {stageMax = n ? n : 1;}
+
+	// Do: Apply staged ops in key order. If buffer is large
+	//	   next to tree, merge both and relink Nodes balanced
+	//	   Either way, only Nodes of erased keys are freed
+	void flush();
+
+	//------------------Relaxed Balance------------------
+	// Red-Black only; other Balance ignore it. Relaxed, insert
+	// links red leaf and, if its parent is red, only notes the
+	// violation: no recolor, no rotate. rebalance() fixes them
+	// later, topmost first. Tree stays a valid search tree, but
+	// is deeper until fixed. Erase fixes all pending first, as
+	// its rebalance needs Red-Black rules to hold
+
+	// Do: Turn relaxed mode on or off (off: fix all now). Each
+	//	   insert then fixes up to perOp pending violations, so
+	//	   with perOp >= 1 they can't pile up. 0: only on
+	//	   rebalance(). Any path past 2 log2(n + 1) is fixed at once
+	void setRelaxed(bool on, size_t perOp = 1);
+
+	// Do: Fix up to budget pending violations, oldest first
+	// Re: Count still pending. At 0, height <= 2 log2(n + 1)
+	size_t rebalance(size_t budget = SIZE_MAX);
+
+	// Re: Count of violations noted, not yet fixed
+	size_t pendingFixes() const {return pending.size();}
+
+	//--------------------Relayout--------------------
+	// Churn scatters Nodes over heap, so search misses cache on
+	// each level. Relayout moves Nodes into 1 block, ordered so
+	// childs sit near parent. Keys (T*) stay put; Nodes move, so
+	// iterators are invalidated. Tree stays fully mutable
+
+	// Do: Move all Nodes into 1 block in order. O(size)
+	void   relayout(Layout order = Layout::VEB);
+
+	// Do: Move next subtree of ~budget Nodes into own block.
+	//	   Subtrees go in key order; Nodes above them, last
+	// Re: true once a pass over whole Tree is complete
+	bool   relayoutStep(size_t budget, Layout order = Layout::VEB);
+
+	// Re: Geometric mean of bytes from Node to its parent, over
+	//	   non-root Nodes: few far jumps between blocks don't
+	//	   swamp it. Lower is better: ~sizeof(Node) at best
+	double layoutDistance() const;
+
+	//--------------------Hash Index--------------------
+	// Optional table from key to Node beside Tree: find(key,
+	// false), erase(key) skip descent, O(1) expected. Ordered
+	// ops still descend. Kept on every change; needs std::hash
+
+	// Do: Build index over all keys (on) or drop it (off)
+	void   setIndexed(bool on);
+	bool   isIndexed () const {return index;}
+
+	// Re: Bytes held by index, 0 if none
+	size_t indexBytes() const {return index ? index->bytes() : 0;}
+
+	//--------------------Split, Join--------------------
+	// O(size): Nodes rebuilt, keys (T*) move without copy. If
+	// Balance relinks (Treap), O(log n) expected: Nodes move as
+	// they are, so iterators stay valid. Not if hash_index or
+	// relayout() blocks, which track Nodes per Tree
+
+	// Do: Move upper half of keys into hi, which is cleared
+	void split(Tree& hi);
+
+	// Do: Move all keys of hi into *this. Every key of hi
+	//	   must be greater than every key of *this
+	void join (Tree& hi);
+
+	//--------------------Bulk Build--------------------
+
+	// Do: Replace contents with keys in range, which may be
+	//	   unsorted and hold duplicates. Sort, dedupe, build
+	//	   subtrees on up to threads threads (0: all cores)
+	template<typename Iter>
+	void assignParallel(Iter it, Iter end, unsigned threads = 0);
+
+	// Re: true if Red-Black, search order, parent links and
+	//	   size all hold. O(size), for tests and debug asserts
+	bool valid() const;
+
+	//--------------------Range Scan--------------------
+	// Do: Call fn(key) on keys in [lo, hi) in order, up to
+	//	   limit. Null lo (hi): from min (to max). 1 descent,
+	//	   then 1 stack walk: no climb to parents per key
+	// Re: Count of keys visited
+	template<class Fn>
+	size_t scan(const T* lo, const T* hi, Fn fn, size_t limit = SIZE_MAX) const;
+
+	//------------------Parallel Traversal------------------
+	// Tree is cut into ~16 in-order tasks per thread: whole
+	// subtrees plus single Nodes above them. Threads claim
+	// next unclaimed task, so a thread stuck on a big subtree
+	// leaves the rest to others. If lo (hi) is non-null, only
+	// keys >= *lo (< *hi) are visited. Tree must not change
+
+	// Do: Call fn(key) on each key, from any thread, any order
+	template<class Fn>
+	void parallelForEach(Fn fn, unsigned threads,
+		const T* lo = nullptr, const T* hi = nullptr) const;
+
+	// Re: init reduced with map(key) of each key, in key order
+	//	   reduce must be associative; map(key) converts to R
+	template<class R, class Reduce, class Map>
+	R	 parallelReduce(R init, Reduce reduce, Map map, unsigned threads,
+		const T* lo = nullptr, const T* hi = nullptr) const;
+
 private:
 	Node*   root;
 	size_t  sz;
+	Node*   first = nullptr; // Leftmost,  min key
+	Node*   last  = nullptr; // Rightmost, max key
+
+	// Ops of (key, toInsert). [0, stagedSorted): in key order,
+	// 1 per key; rest: in order of call to stage(). stage()
+	// sorts the rest in once it outgrows a scan
+	std::vector<std::pair<T, bool>> staged;
+	size_t stagedSorted = 0;
+	size_t stageMax = 64;
+
+	// Keys staged ops add less those they erase, if netKnown.
+	// Atomic: const stagedNet() sets it, maybe on many threads
+	mutable std::atomic<ptrdiff_t> net{0};
+	mutable std::atomic<bool>	   netKnown{false};
+
+	// Helper: Sort ops past stagedSorted into those before, so
+	// that all are in key order, newest op per key only
+	void  sortStaged();
+
+	// Helper: Sort tail in if long. If netKnown, count key's
+	//		   op in net, before it is staged
+	void  countStaged(const T& key, bool toInsert);
+
+	// Helper: net of staged ops, found anew. Reads only
+	ptrdiff_t countNet() const;
+
+	// eraseIf relinks once 1 / eraseIfRebuild of keys go. Both
+	// ways cost about the same near 55% (bench eraseif): relink
+	// rewrites every kept Node, however few keys go
+	static constexpr size_t eraseIfRebuild = 2;
+
+	// Relaxed: red Nodes left with red parent by insert, oldest
+	// first. Entries fixed in passing by other repairs remain
+	std::deque<Node*> pending;
+	bool   relaxed	 = false;
+	size_t relaxStep = 0;
+
+	// Blocks of Nodes placed by relayout, sorted by begin. Block
+	// is freed once all its Nodes are. layoutFrom: copy of min
+	// key of next subtree relayoutStep moves; null: pass starts
+	struct Arena {Node* begin; size_t size, live;};
+	std::vector<Arena> arenas;
+	T*				   layoutFrom = nullptr;
+
+	KeyIndex<T, Node>* index = nullptr;
+
+	void setLayoutFrom(const T* key) {
+		delete layoutFrom;
+		layoutFrom = key ? new T(*key) : nullptr;
+	}
 	inline static Compare cmp = Compare(); // In C++ < 17, omit "inline static" 
 
-	// Helper to restore Red-Black properties
-	void balanceInsert(Node* current);
-	void balanceErase (Node* toErase);
+	friend Balance;
+
+	// Helper: Rotate x above its parent. Inorder is unchanged
+	void  rotateUp(Node* x);
+
+	// Helper: Swap places of a, b in Tree: links, and fields
+	//		   Balance, Digest keep per place. Keys stay. a must
+	//		   be above b, as erase's Node above its successor
+	void  swapNodes(Node* a, Node* b);
+
+	// Helper: If index, refill it from all Nodes
+	void  reindex();
+
+	// Helper: Put node's sole child (may be null) in its place
+	void  splice(Node* node);
+
+	// Helper: Take node out of Tree, as eraseNode, but not free
+	//		   it; its links are stale. Re: Node of successor key
+	Node* unlinkNode(Node* node);
+
+	// Helper: Hang leaf added under parent (null: as root), on
+	//		   side its key falls, then index and balance it
+	void  attach(Node* added, Node* parent);
+
+	// Helper: If Hashed, recompute node's Digest from its
+	// childs' (refresh) or that of node and all its ancestors
+	void  refresh  (Node* node);
+	void  refreshUp(Node* node);
+
+	// Helper: Digest of keys in (lo, hi), null bound: none
+	Digest<Hashed> rangeDigest(const T* lo, const T* hi) const;
+
+	// Helper: Digest of keys < key (orEqual: <= key)
+	Digest<Hashed> prefixDigest(const T& key, bool orEqual) const;
+
+	// Helper: Append keys in (lo, hi) to out, or those in diff
+	void  collect(const T* lo, const T* hi, std::vector<T>& out) const;
+	void  diff(const Tree& o, const T* lo, const T* hi,
+		std::vector<T>& out) const;
+
+	// Helper: Search for key in subtree of current, as find()
+	Node* descend(Node* current, const T& key, bool getClosest) const;
+
+	// Helper: Set first, last by descent from root
+	void  resetEnds();
+
+	// Helper: Delete subtree of node without recursion, as
+	// relaxed Tree may be deep. Rotate left child up until
+	// none, then delete node, go right: O(size), no stack
+	void  destroy(Node* node);
+
+	// Helper: Free childless node, to its block or by delete
+	void  freeNode(Node* node);
+
+	// Helper: Append Nodes of node's subtree at depth < levels
+	// below it, in order. height: its levels, without recursion
+	void  layout(Node* node, size_t levels, Layout order,
+		std::vector<Node*>& out) const;
+	static size_t height(Node* node);
+
+	// Helper: Move nodes into new block in their order. Links
+	// to Nodes not moved are kept, and theirs fixed
+	void  relocate(const std::vector<Node*>& nodes);
+
+	// Helper: Append T* of all keys in order. Leave Tree empty
+	void  release(std::vector<T*>& keys);
+
+	// Helper: Replace contents with balanced tree over keys,
+	// which must be sorted and unique. Tree adopts each T*
+	void  build(const std::vector<T*>& keys);
+
+	// Helper: Link nodes[lo, hi), in key order, into balanced
+	// subtree as build() does, but reuse Nodes: no allocation
+	Node* relink(const std::vector<Node*>& nodes, size_t lo, size_t hi,
+		Node* parent, size_t depth, size_t redDepth);
+
+	// Helper: Merge sorted runs keys[cut[i], cut[i + 1]) in
+	// place, on 1 thread per run
+	static void mergeParallel(std::vector<T>& keys, const std::vector<size_t>& cut);
+
+	// Helper: Subtree over keyAt(i), i in [lo, hi). Split
+	// halves over threads while threads > 1
+	template<typename KeyAt>
+	Node* build(const KeyAt& keyAt, size_t lo, size_t hi,
+		Node* parent, size_t depth, size_t redDepth, unsigned threads);
+
+	// Helper: Cut Tree's keys in [lo, hi) into tasks for
+	// threads. Task: (Node, true if whole subtree)
+	std::vector<std::pair<Node*, bool>> tasksFor(unsigned threads,
+		const T* lo, const T* hi) const;
+	void cutTasks(Node* node, size_t depth, size_t maxDepth,
+		const T* lo, const T* hi,
+		std::vector<std::pair<Node*, bool>>& tasks) const;
+
+	// Helper: Run work(i, tasks[i]) for each task on threads
+	template<class Work>
+	void parallelTasks(unsigned threads,
+		const std::vector<std::pair<Node*, bool>>& tasks, const Work& work) const;
+
+	// Helper: Call fn(key) on keys of subtree in [lo, hi), in
+	// order, up to limit. Stack-based, with prefetch of next
+	// Nodes. Re: Count of keys visited
+	template<class Fn>
+	size_t visit(Node* node, const T* lo, const T* hi, Fn& fn,
+		size_t limit = SIZE_MAX) const;
+
+	// Helper: Balance::check of subtree, or 0 if it is invalid
+	// Key of node must be within (lo, hi) if each is non-null
+	size_t valid(const Node* node, const Node* parent,
+		const T* lo, const T* hi, size_t& count) const;
 };
 
 // Red-Black Tree backend enables ordered key iteration
-template<class T, class Compare>
+// Threads: const ops are safe to run concurrently only while
+// no op is deferred (see Buffered Modifiers). If any is, const
+// find, begin, lower_bound, scan .. flush it, so write Set:
+// flush() before sharing. size, empty, count, contains only read
+template<class T, class Compare, class Balance, bool Hashed>
 class Set {
-	Tree<T, Compare>* tree;
+	// Null till first modifier, and once moved from: empty Set
+	// and move allocate no Tree
+	Tree<T, Compare, Balance, Hashed>* tree;
+
+	// Re: Empty Tree, shared, never modified: reads of a Set
+	//	   without Tree see it, so stay allocation-free
+	static Tree<T, Compare, Balance, Hashed>* none() {
+		static Tree<T, Compare, Balance, Hashed> empty;
+		return &empty;
+	}
+
+	// Re: Set's Tree. Modifiers allocate one if none yet
+	Tree<T, Compare, Balance, Hashed>* at() {
+		if (!tree) tree = new Tree<T, Compare, Balance, Hashed>();
+		return tree;
+	}
+	Tree<T, Compare, Balance, Hashed>* at() const {return tree ? tree : none();}
+
+	// Do: Apply deferred ops before any op that needs Tree exact
+	void sync() const {if (tree && tree->hasStaged()) tree->flush();}
+
+	// Re: true if flush will free it's Node, as last deferred
+	//	   op on its key is erase. Flush keeps all other Nodes
+	bool isStagedErase(const auto& it) const {
+		return it.ptr && at()->hasStaged() && at()->stagedOp(**it.ptr) < 0;
+	}
+
+	// Do: sync(). Re: Node for search to start from: hint's,
+	//	   or null (root) if flush frees it
+	auto* syncHint(const auto& hint) const {
+		auto* from = isStagedErase(hint) ? nullptr : hint.ptr;
+		sync();
+		return from;
+	}
+
+	// Do: sync(). Re: it's Node after: the same, unless flush
+	//	   frees it; then Node of next-higher key. end(): null
+	auto* resync(const auto& it) const {
+		auto* node = it.ptr;
+		if (!isStagedErase(it)) {
+			sync();
+			return node;
+		}
+		T key(**node);
+		sync();
+		node = at()->find(key);
+		if (node && at()->less(**node, key)) node = node->inorderNext();
+		return node;
+	}
 public:
 	
 	// For Set, const_iterator and iterator function identically
 	// as keys cannot be modified (only erased and reinserted)
 	class iterator {
-		friend Set <T, Compare>;
-		friend Tree<T, Compare>;
-		Tree<T, Compare>*		tree;
-		Tree<T, Compare>::Node* ptr;
-		bool					isForward;
+		friend Set <T, Compare, Balance, Hashed>;
+		friend Tree<T, Compare, Balance, Hashed>;
+		Tree<T, Compare, Balance, Hashed>*		 tree;
+		Tree<T, Compare, Balance, Hashed>::Node* ptr;
+		bool							 isForward;
 
 		// Private to ensure tree != null as only Set, 
 		// which initialized tree, can initialize iterator
 		iterator(
-			Tree<T, Compare>* tree,
-			Tree<T, Compare>::Node* ptr,
+			Tree<T, Compare, Balance, Hashed>* tree,
+			Tree<T, Compare, Balance, Hashed>::Node* ptr,
 			bool isForward = true):
 			tree(tree), ptr(ptr), isForward(isForward) {}
 	public:
+		// Singular, as std's: only to assign to. For iterator
+		// to be std::regular, as ranges require
+		iterator(): tree(nullptr), ptr(nullptr), isForward(true) {}
+
 		using iterator_category = std::bidirectional_iterator_tag;
 		using difference_type   = std::ptrdiff_t;
 		using value_type        = const T;
@@ -184,21 +901,22 @@ public:
 
 		iterator(const iterator& oth):
 			tree(oth.tree), ptr(oth.ptr), isForward(oth.isForward) {}
-		iterator& operator=(const Set<T, Compare>::iterator& oth) {
+		iterator& operator=(const Set<T, Compare, Balance, Hashed>::iterator& oth) {
 			tree = oth.tree; ptr = oth.ptr; isForward = oth.isForward;
 			return *this;
 		}
 
-		bool operator==(const iterator& o) {
+		bool operator==(const iterator& o) const {
 			assert(isForward == o.isForward &&
 				"Cannot compare iterator[forward] and "
 				"iterator[reversed] types of RedBlack::Set");
-			assert(tree == o.tree			&&
+			// Iterator taken while Set had no Tree holds none()
+			assert((tree == o.tree || tree == none() || o.tree == none()) &&
 				"Cannot compare iterators to different RedBlack::Set objects");
 
 			return ptr == o.ptr;
 		};
-		bool operator!=(const iterator& o) { return !(*this == o); };
+		bool operator!=(const iterator& o) const { return !(*this == o); };
 
 		reference operator *() const {
 			if (ptr) return **ptr;
@@ -274,10 +992,11 @@ public:
 			return tmp;
 		}
 	};
-	iterator begin (){ return iterator(tree, tree->min());}
-	iterator end   (){ return iterator(tree, nullptr);}
-	iterator rbegin(){ return iterator(tree, tree->max(), false);}
-	iterator rend  (){ return iterator(tree, nullptr, false);}
+	// Const too: keys can't be modified thru iterator anyway
+	iterator begin () const { sync(); return iterator(at(), at()->min());}
+	iterator end   () const { return iterator(at(), nullptr);}
+	iterator rbegin() const { sync(); return iterator(at(), at()->max(), false);}
+	iterator rend  () const { return iterator(at(), nullptr, false);}
 
 	using difference_type = iterator::difference_type;
 	using value_compare   = Compare;
@@ -287,32 +1006,49 @@ public:
 	using value_type	  = T;
 	using key_type		  = T;
 
-	Set(): tree(new Tree<T, Compare>()) {}
+	// Do: No Tree till first modifier: empty Sets cost 1 pointer
+	//	   end() taken before then can't be decremented after
+	Set(): tree(nullptr) {}
 
 	// Do: Add all keys within range into Set
 	template<typename Iter>
-	Set(Iter it, Iter end): tree(new Tree<T, Compare>(it, end)) {}
-	Set(std::initializer_list<T> keys) :
-		tree(new Tree<T, Compare>(keys)) {}
+	Set(Iter it, Iter end): tree(new Tree<T, Compare, Balance, Hashed>(it, end)) {}
 
-	Set(const Set& src): tree(new Tree<T, Compare>(*(src.tree))) {}
-	Set(Set&& src) noexcept: tree(new Tree<T, Compare>()) {
-		swap(this->tree, src.tree);
+	// Re: Set of keys in range, built on threads (0: all cores)
+	//	   Faster than Set(Iter, Iter) for large, unsorted input
+	template<typename Iter>
+	static Set build_parallel(Iter it, Iter end, unsigned threads = 0) {
+		Set s;
+		s.at()->assignParallel(it, end, threads);
+		return s;
 	}
+	Set(std::initializer_list<T> keys) :
+		tree(new Tree<T, Compare, Balance, Hashed>(keys)) {}
+
+	Set(const Set& src): tree(src.tree ?
+		new Tree<T, Compare, Balance, Hashed>(*src.tree) : nullptr) {}
+
+	// Do: Steal src's Tree, no allocation. src reads as empty
+	//	   and allocates a Tree on its next modifier
+	Set(Set&& src) noexcept: tree(src.tree) {src.tree = nullptr;}
 	Set& operator=(Set&& src) noexcept {
 		swap(*this, src);
 		return *this;
 	}
 	Set& operator=(const Set& src) {
-		*tree = *src.tree; return *this;
+		if (this == &src) return *this;
+		if (src.tree) *at() = *src.tree;
+		else		  clear();
+		return *this;
 	}
 
 	// Note: Sets to match keys, not structure of Tree
-	bool operator==(const Set& oth) {
-		return *tree == *oth.tree;
+	bool operator==(const Set& oth) const {
+		sync(); oth.sync();
+		return *at() == *oth.at();
 	}
-	bool operator!=(const Set& oth) {
-		return *tree != oth.tree;
+	bool operator!=(const Set& oth) const {
+		return !(*this == oth);
 	}
 
 	~Set() { delete tree; }
@@ -322,21 +1058,29 @@ public:
 	// Re: Count of inserts of keys not already present
 	template<class Iter>
 	size_t insert(Iter it, Iter end) {
-		return tree->insert(it, end);
+		sync(); return at()->insert(it, end);
 	}
 	size_t insert(std::initializer_list<T> keys) {
-		return tree->insert(keys);
+		sync(); return at()->insert(keys);
 	}
 
 	// Re: (1) holds * to key in Set
 	//	   (2) == true if key was not already present
 	std::pair<iterator, bool> insert(	  T&& key) {
-		auto x = tree->insert(key, true);  // Move T key
-		return {iterator(tree, x.first), x.second};
+		sync();
+		auto x = at()->insert(key, true);  // Move T key
+		return {iterator(at(), x.first), x.second};
 	}
 	std::pair<iterator, bool> insert(const T& key) {
-		auto x = tree->insert(key, false); // Copy T key
-		return {iterator(tree, x.first), x.second};
+		sync();
+		auto x = at()->insert(key, false); // Copy T key
+		return {iterator(at(), x.first), x.second};
+	}
+
+	// Re: Same as insert(key). Search starts at hint, not root
+	iterator insert(iterator hint, const T& key) {
+		auto* from = syncHint(hint);
+		return iterator(at(), at()->insert(key, false, from).first);
 	}
 
 	// Re: (1) holds * to key in Set, (2) == True if success
@@ -350,57 +1094,246 @@ public:
 	// Re: Count of keys erased
 	template<class Iter>
 	size_t erase(Iter it, Iter end) {
-		return tree->erase(it, end);
+		sync(); return at()->erase(it, end);
+	}
+	size_t erase(iterator it, iterator end) {
+		// Flush may free Node of either bound: take end by key,
+		// as range is [*it, *end) in key order
+		if (end.ptr && at()->hasStaged()) {
+			T to(*end);
+			it.ptr	= resync(it);
+			end.ptr = lower_bound(to).ptr;
+		}
+		else it.ptr = resync(it);
+		return at()->erase(it, end);
+	}
+
+	// Do: Erase keys where pred(key) (erase_if), or keep only
+	//	   those (retain). Many erased: Tree is relinked in O(n)
+	//	   Iterators to kept keys stay valid
+	// Re: Count of keys erased
+	template<class Pred>
+	size_t erase_if(Pred pred) {sync(); return at()->eraseIf(pred);}
+	template<class Pred>
+	size_t retain  (Pred pred) {
+		sync(); return at()->eraseIf([&pred](const T& key) {return !pred(key);});
 	}
 	size_t erase(std::initializer_list<T> keys) {
-		return tree->erase(keys.begin(), keys.end());
+		sync(); return at()->erase(keys.begin(), keys.end());
 	}
 
 	// Re: If (2) == true , (1) holds * to key's successor 
 	//	   If (2) == false, (1) is Set::end(), holds null
 	std::pair<iterator, bool> erase(const T& key) {
-		auto x = tree->erase(key);
-		return {iterator(tree, x.first), x.second};
+		sync();
+		auto x = at()->erase(key);
+		return {iterator(at(), x.first), x.second};
 	}
-	template<class Iter>
-	std::pair<iterator, bool> erase(Iter it) {
-		return erase(*it);
+	// Do: Erase its own Node: no search. O(1) amortized, and
+	//	   iterators to other keys stay valid
+	// Re: (1) holds its next: successor, or if reversed, predecessor
+	std::pair<iterator, bool> erase(iterator it) {
+		auto* node = it.ptr;
+		if (!node) return {iterator(at(), nullptr, it.isForward), false};
+
+		// Flush keeps Nodes, but deferred erase of its key frees it
+		bool isGone = isStagedErase(it);
+		sync();
+		if (isGone) return {iterator(at(), nullptr, it.isForward), false};
+
+		auto* prev = it.isForward ? nullptr : node->inorderPrev();
+		auto* next = at()->eraseNode(node);
+		return {iterator(at(), it.isForward ? next : prev, it.isForward), true};
+	}
+
+	// Do: Swap Trees: iterators follow their keys to the other Set
+	friend void swap(Set& a, Set& b) noexcept {std::swap(a.tree, b.tree);}
+
+	void clear() noexcept { if (tree) tree->clear(); }
+
+	//-----------------Priority Queue-----------------
+	// For Set as ordered queue: ends are cached, no descent
+
+	// Re: Min (front) or max (back) key. Set must not be empty
+	const T& front() const {
+		sync();
+		if (at()->size()) return **at()->min();
+		throw new std::out_of_range("front() on empty RedBlack::Set");
+	}
+	const T& back () const {
+		sync();
+		if (at()->size()) return **at()->max();
+		throw new std::out_of_range("back() on empty RedBlack::Set");
+	}
+
+	// Do: Erase min (front) or max (back) key without search
+	// Re: Erased key, moved out. Set must not be empty
+	T pop_front() {
+		sync();
+		if (at()->size()) return at()->popEnd(false);
+		throw new std::out_of_range("pop_front() on empty RedBlack::Set");
 	}
+	T pop_back () {
+		sync();
+		if (at()->size()) return at()->popEnd(true);
+		throw new std::out_of_range("pop_back() on empty RedBlack::Set");
+	}
+
+	// Do: Replace key at it with key. If key stays between
+	//	   its neighbors, overwrite in place; else, move Node
+	//	   to key's place. Either way it stays valid
+	// Re: (1) holds * to key
+	//	   (2) == false if key was held by other Node, in which
+	//		   case Set is unchanged
+	// If deferred erase frees it's Node, only insert key
+	std::pair<iterator, bool> update_key(iterator it, const T& key) {
+		if (isStagedErase(it)) return insert(key);
+		sync();
+		auto x = at()->updateKey(it.ptr, key, false);
+		return {iterator(at(), x.first), x.second};
+	}
+	std::pair<iterator, bool> update_key(iterator it, 	   T&& key) {
+		if (isStagedErase(it)) return insert((T&&)key);
+		sync();
+		auto x = at()->updateKey(it.ptr, key, true);
+		return {iterator(at(), x.first), x.second};
+	}
+
+	//------------------Buffered Modifiers------------------
+	// For bursts: stage op without linking it into Tree; only a
+	// find (O(1) if hash_index) to keep size() exact. count(),
+	// contains(), size(), empty() read buffer; other ops flush
+	// it first, so stay exact. Flush frees only Nodes of erased
+	// keys: iterators to other keys stay valid
+	// While ops are staged, other const ops (find, begin,
+	// lower_bound ..) flush: not safe from concurrent readers
+	// flush() before sharing Set to read
 
-	friend void swap(Set& a, Set& b) noexcept {swap(*a.tree, *b.tree);}
+	void defer_insert(const T& key) {at()->stage(key, true);}
+	void defer_insert(	   T&& key) {at()->stage((T&&)key, true);}
+	void defer_erase (const T& key) {at()->stage(key, false);}
 
-	void clear() noexcept { tree->clear(); }
+	// Do: Auto flush once buffer holds n ops (n == 0: as 1)
+	void buffer(size_t n) {at()->setStageMax(n); sync();}
+	void flush() {at()->flush();}
 
 	//--------------------Operations--------------------
 
-	// Re: If key is in Set, true; else, false
-	bool	 count(const T& key) const {
-		return tree->find(key, false);
+	// Re: If key is in Set, true; else, false. Reads deferred
+	//	   ops without flush
+	bool	 count	 (const T& key) const {
+		if (int op = at()->stagedOp(key)) return op > 0;
+		return at()->find(key, false);
 	}
+	bool	 contains(const T& key) const {return count(key);}
 
-	// Re: If key is in Set, holds * to key; else, null
+	// Re: If key is in Set, holds * to key; else, null. Key of
+	//	   deferred erase: null without flush. Else flush, as
+	//	   iterator walks Nodes, which must hold all keys
 	iterator find(const T& key) const {
-		return iterator(tree, tree->find(key, false));
+		if (at()->stagedOp(key) < 0) return iterator(at(), nullptr);
+		sync();
+		return iterator(at(), at()->find(key, false));
+	}
+
+	//--------------------Range Scan--------------------
+	// For export, paging: 1 descent to lo, then 1 in-order stack
+	// walk with prefetch. No per-key checks as iterator's ++()
+
+	// Do: fn(key) on keys in [lo, hi) (or >= lo) in order, up
+	//	   to limit keys. Re: Count of keys visited
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, const T& hi, Fn fn, size_t limit = SIZE_MAX) const {
+		sync(); return at()->scan(&lo, &hi, fn, limit);
+	}
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, Fn fn, size_t limit = SIZE_MAX) const {
+		sync(); return at()->scan(&lo, nullptr, fn, limit);
+	}
+
+	// Do: Copy keys in [lo, hi) (or >= lo) in order into out,
+	//	   up to out.size(). Re: Count of keys copied
+	size_t scan(const T& lo, const T& hi, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, hi, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+	size_t scan(const T& lo, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+
+	// Re: Lazy view of keys in [lo, hi): bounds found now,
+	//	   keys read as view is iterated, either way
+	std::ranges::subrange<iterator> range(const T& lo, const T& hi) const {
+		static_assert(std::ranges::bidirectional_range<
+			std::ranges::subrange<iterator>>);
+		iterator from = lower_bound(lo);
+		if (!at()->less(lo, hi)) return {from, from};
+		return {from, lower_bound(hi)};
+	}
+
+	//--------------------Finger Search--------------------
+	// Search from hint's Node, not root: for probes near in key
+	// order to last one. end() as hint searches from root
+
+	iterator find_from(iterator hint, const T& key) const {
+		auto* from = syncHint(hint);
+		return iterator(at(), at()->findFrom(from, key, false));
+	}
+	iterator lower_bound_from(iterator hint, const T& key) const {
+		typename Tree<T, Compare, Balance, Hashed>::Node* x =
+			at()->findFrom(syncHint(hint), key);
+		if (x &&  at()->less(**x, key)) x = x->inorderNext();
+		return iterator(at(), x);
+	}
+
+	// Do: *out++ = lower_bound(key) per key of ascending range,
+	//	   each search from last result
+	template<class Iter, class Out>
+	Out lower_bound_sorted(Iter it, Iter end, Out out) const {
+		iterator hint(at(), nullptr);
+		for (; it != end; it++) {
+			iterator x = lower_bound_from(hint, *it);
+			if (x.ptr) hint = x;
+			*out++ = x;
+		}
+		return out;
+	}
+
+	// Do: *out++ = count(key) per key of ascending range
+	template<class Iter, class Out>
+	Out count_sorted(Iter it, Iter end, Out out) const {
+		sync();
+		typename Tree<T, Compare, Balance, Hashed>::Node* hint = nullptr;
+		for (; it != end; it++) {
+			typename Tree<T, Compare, Balance, Hashed>::Node* x =
+				at()->findFrom(hint, *it);
+			if (x) hint = x;
+			*out++ = x && at()->same(**x, *it);
+		}
+		return out;
 	}
 
 	// Re: min(x) >=key. If key is in Set, holds * to key
 	//	   If not, holds * to key's successor
 	iterator lower_bound(const T& key) const {
-		typename Tree<T, Compare>::Node* x = tree->find(key);
-		if (x &&  tree->less(**x, key)) { // If x <  key
+		sync();
+		typename Tree<T, Compare, Balance, Hashed>::Node* x = at()->find(key);
+		if (x &&  at()->less(**x, key)) { // If x <  key
 			x = x->inorderNext();
 		}
-		return iterator(tree, x);
+		return iterator(at(), x);
 	}
 
 	// Re: min(x) > key. Even if key is found, upper_bound(),
 	//	   unlike lower_bound(), holds * to key's successor
 	iterator upper_bound(const T& key) const {
-		typename Tree<T, Compare>::Node* x = tree->find(key);
-		if (x && !tree->less(key, **x)) { // If x <= key
+		sync();
+		typename Tree<T, Compare, Balance, Hashed>::Node* x = at()->find(key);
+		if (x && !at()->less(key, **x)) { // If x <= key
 			x = x->inorderNext();
 		}
-		return iterator(tree, x);
+		return iterator(at(), x);
 	}
 
 	// Re: If key is in Set, hold * to (key, successor)
@@ -412,13 +1345,123 @@ public:
 
 	//--------------------Observers--------------------
 
-	size_t size () const noexcept { return tree->size(); }
-	bool   empty() const noexcept { return tree->size() == 0; }
+	// Count deferred ops without flush. First call after burst
+	// finds each staged key, O(m log n): may throw, as Compare
+	size_t size () const { return at()->size() + at()->stagedNet(); }
+	bool   empty() const { return size() == 0; }
+
+	// Re: true if Tree's invariants hold. O(size)
+	bool   valid() const { sync(); return at()->valid(); }
+
+	//--------------------Relayout--------------------
+	// After long churn, Nodes lie scattered over heap and each
+	// level of search misses cache. Relayout packs them into 1
+	// block, childs near parents. Invalidates all iterators
+
+	// Do: Pack all Nodes in van Emde Boas (or preorder) order
+	void   relayout(Layout order = Layout::VEB) {sync(); at()->relayout(order);}
+
+	// Do: Pack next ~budget Nodes, as from idle time or timer
+	// Re: true once a whole pass is done
+	bool   relayout_step(size_t budget, Layout order = Layout::VEB) {
+		sync(); return at()->relayoutStep(budget, order);
+	}
+
+	// Re: Typical bytes from Node to parent. Compare before, after
+	double layout_distance() const {sync(); return at()->layoutDistance();}
+
+	//--------------------Hash Index--------------------
+	// For point-lookup heavy use: hash table key -> Node beside
+	// Tree makes find, count, erase(key) O(1) expected; absent
+	// keys mostly answered from 1-byte tags. Ordered ops still
+	// descend Tree. Needs std::hash<T>
+
+	// Do: Keep index (on) or drop it (off)
+	void   hash_index(bool on = true) {sync(); at()->setIndexed(on);}
+
+	// Re: Bytes index holds (0 if off): its cost for this Set
+	size_t index_bytes() const {return at()->indexBytes();}
+
+	//------------------Relaxed Balance------------------
+	// Red-Black only. For bursts of inserts: insert skips its
+	// fixup, noting red-red violations to fix later. Lookups
+	// stay exact but walk a deeper Tree until rebalance()
+
+	// Do: Relax (on) or fix all and stop (off). Each insert
+	//	   then fixes up to perOp noted violations (0: none till
+	//	   rebalance). No insert links deeper than 2 log2(n + 1)
+	void   relax(bool on = true, size_t perOp = 1) {at()->setRelaxed(on, perOp);}
+
+	// Do: Fix up to budget violations, as from idle time
+	// Re: Count still pending. At 0, Red-Black rules hold
+	size_t rebalance(size_t budget = SIZE_MAX) {sync(); return at()->rebalance(budget);}
+
+	//------------------Parallel Traversal------------------
+	// Split at subtree boundaries over threads (0: all cores)
+	// Range versions visit only keys in [lo, hi)
+
+	// Do: Call fn(key) on each key. fn runs on many threads
+	//	   at once, in no order, so must be thread-safe
+	template<class Fn>
+	void parallel_for_each(Fn fn, unsigned threads = 0) const {
+		sync(); at()->parallelForEach(fn, threads);
+	}
+	template<class Fn>
+	void parallel_for_each(const T& lo, const T& hi, Fn fn,
+		unsigned threads = 0) const {
+		sync(); at()->parallelForEach(fn, threads, &lo, &hi);
+	}
+
+	// Re: reduce(..reduce(reduce(init, map(k1)), map(k2)).., map(kn))
+	//	   by key order. reduce must be associative, not commutative
+	template<class R, class Reduce, class Map>
+	R parallel_reduce(R init, Reduce reduce, Map map,
+		unsigned threads = 0) const {
+		sync(); return at()->parallelReduce(init, reduce, map, threads);
+	}
+	template<class R, class Reduce, class Map>
+	R parallel_reduce(const T& lo, const T& hi, R init, Reduce reduce,
+		Map map, unsigned threads = 0) const {
+		sync();
+		return at()->parallelReduce(init, reduce, map, threads, &lo, &hi);
+	}
+
+	// Re: Count of keys for which pred(key) == true
+	template<class Pred>
+	size_t parallel_count_if(Pred pred, unsigned threads = 0) const {
+		return parallel_reduce(size_t(0), std::plus<size_t>(),
+			[&pred](const T& key) -> size_t {return pred(key);}, threads);
+	}
+	template<class Pred>
+	size_t parallel_count_if(const T& lo, const T& hi, Pred pred,
+		unsigned threads = 0) const {
+		return parallel_reduce(lo, hi, size_t(0), std::plus<size_t>(),
+			[&pred](const T& key) -> size_t {return pred(key);}, threads);
+	}
+
+	//--------------------Digest--------------------
+	// Only for Set<T, Compare, Balance, true>: for replicas
+
+	// Re: Hash of keys in order. Equal Sets, equal digests
+	uint64_t digest() const {sync(); return at()->digest();}
+
+	// Re: Keys in exactly 1 of *this, oth, ascending. Cost
+	//	   grows with count of differences, not with size
+	std::vector<T> diff(const Set& oth) const {
+		sync(); oth.sync();
+		return at()->diff(*oth.at());
+	}
 
 	// Re: Usually std::less<T>
 	key_compare   key_comp  () const {return Compare();}
 	value_compare value_comp() const {return Compare();}
 };
 
+// Re: Count of keys erased, as std::erase_if(std::set) does
+template<class T, class Compare, class Balance, bool Hashed, class Pred>
+size_t erase_if(Set<T, Compare, Balance, Hashed>& set, Pred pred) {
+	return set.erase_if(pred);
+}
+
 #include "RedBlack.inl"
 } // namespace RedBlack closed
\ No newline at end of file
@@ -6,9 +6,9 @@
 // Erase:
 // https://www.geeksforgeeks.org/deletion-in-red-black-tree/
 
-template<class T, class Compare>
-typename Tree<T, Compare>::Node*
-Tree<T, Compare>::Node::sibling() {
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::Node::sibling() {
 	if (parent) {
 		if (this == parent->left) return parent->right;
 		else return parent->left;
@@ -16,9 +16,9 @@ Tree<T, Compare>::Node::sibling() {
 	else return nullptr;
 }
 
-template<class T, class Compare>
-typename Tree<T, Compare>::Node*
-Tree<T, Compare>::Node::inorderNext() {
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::Node::inorderNext() {
 	Node* current = this;
 	if (current->right) {
 		current = current->right;
@@ -41,9 +41,9 @@ Tree<T, Compare>::Node::inorderNext() {
 	return nullptr;
 }
 
-template<class T, class Compare>
-typename Tree<T, Compare>::Node*
-Tree<T, Compare>::Node::inorderPrev() {
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::Node::inorderPrev() {
 	Node* current = this;
 	if (current->left) {
 		current = current->left;
@@ -65,42 +65,42 @@ Tree<T, Compare>::Node::inorderPrev() {
 	return nullptr;
 }
 
-template<class T, class Compare>
-typename Tree<T, Compare>::Node* Tree<T, Compare>::min() const {
-	Node* current = root;
-	if (current) {
-		while (current->left) current = current->left;
-	}
-	return current;
-}
-
-template<class T, class Compare>
-typename Tree<T, Compare>::Node* Tree<T, Compare>::max() const {
-	Node* current = root;
-	if (current) {
-		while (current->right) current = current->right;
+// Helper: Descend to leftmost, rightmost Node for min, max
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::resetEnds() {
+	first = last = root;
+	if (root) {
+		while (first->left ) first = first->left;
+		while (last ->right) last  = last ->right;
 	}
-	return current;
 }
 
 // Traverse preorder. On Node*, push ->right to stack, then
 // traverse ->left. If ->left doesn't exist, go to stack.top()
-template<class T, class Compare>
-Tree<T, Compare>::Tree(const Tree<T, Compare>& src) {
+template<class T, class Compare, class Balance, bool Hashed>
+Tree<T, Compare, Balance, Hashed>::Tree(const Tree<T, Compare, Balance, Hashed>& src):
+	staged(src.staged), stagedSorted(src.stagedSorted), stageMax(src.stageMax),
+	net(src.net.load()), netKnown(src.netKnown.load()),
+	relaxed(src.relaxed), relaxStep(src.relaxStep) {
 	if (!src.root) {
 		root = nullptr;
 		sz   = 0;
 		return;
 	}
-	root = new Node(*src.root->key);
+	root = new Node(*src.root->key, false);
+	root->copyAux(src.root);
 	sz	 = src.sz;
 
+	// Note red-red edges anew: src's pending hold src's Nodes
+	bool  fix = !src.pending.empty();
 	Node *ptr = root, *srcPtr = src.root;
-	std::stack<Tree<T, Compare>::Node*> stack;
+	std::stack<Tree<T, Compare, Balance, Hashed>::Node*> stack;
 	while (true) {
 		if (srcPtr->right) {
 			ptr->right = new Node(
 				*srcPtr->right->key, srcPtr->right->isRed, ptr);
+			ptr->right->copyAux(srcPtr->right);
+			if (fix && ptr->right->isRed && ptr->isRed) pending.push_back(ptr->right);
 
 			stack.push(ptr->right); stack.push(srcPtr->right);
 		}
@@ -108,6 +108,8 @@ Tree<T, Compare>::Tree(const Tree<T, Compare>& src) {
 		if (srcPtr->left) {
 			ptr->left = new Node(
 				*srcPtr->left->key, srcPtr->left->isRed, ptr);
+			ptr->left->copyAux(srcPtr->left);
+			if (fix && ptr->left->isRed && ptr->isRed) pending.push_back(ptr->left);
 
 			srcPtr = srcPtr->left; ptr = ptr->left;
 		}
@@ -117,12 +119,21 @@ Tree<T, Compare>::Tree(const Tree<T, Compare>& src) {
 		}
 		else break;
 	}
+	resetEnds();
+
+	if (src.index) {
+		index = new KeyIndex<T, Node>(src.index->hashOf());
+		reindex();
+	}
 }
 
-template<class T, class Compare>
-bool Tree<T, Compare>::operator==(const Tree<T, Compare>& o) {
+template<class T, class Compare, class Balance, bool Hashed>
+bool Tree<T, Compare, Balance, Hashed>::operator==(const Tree<T, Compare, Balance, Hashed>& o) const {
 	if (this == &o) return true;
 	if (sz != o.sz) return false;
+	if constexpr (Hashed) {
+		if (root && root->hash != o.root->hash) return false;
+	}
 
 	Node* tNode =   min();
 	Node* oNode = o.min();
@@ -135,92 +146,288 @@ bool Tree<T, Compare>::operator==(const Tree<T, Compare>& o) {
 	return true;
 }
 
+//--------------------Digest--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+uint64_t Tree<T, Compare, Balance, Hashed>::digest() const {
+	static_assert(Hashed, "digest() needs Tree<.., Hashed = true>");
+	return root ? root->hash : 0;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+std::vector<T> Tree<T, Compare, Balance, Hashed>::diff(const Tree& o) const {
+	static_assert(Hashed, "diff() needs Tree<.., Hashed = true>");
+	std::vector<T> out;
+	diff(o, nullptr, nullptr, out);
+	return out;
+}
+
+// Pivot on highest Node of *this inside (lo, hi): ranges on
+// either side follow *this's subtrees, so recursion is only
+// as deep as *this. Range equal in both trees is skipped
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::diff(const Tree& o,
+	const T* lo, const T* hi, std::vector<T>& out) const {
+	Digest<Hashed> mine = rangeDigest(lo, hi), theirs = o.rangeDigest(lo, hi);
+	if (mine.count == theirs.count && mine.hash == theirs.hash) return;
+	if (!mine  .count) {o.collect(lo, hi, out); return;}
+	if (!theirs.count) {  collect(lo, hi, out); return;}
+
+	Node* pivot = root;
+	while ((lo && !cmp(*lo, *pivot->key)) || (hi && !cmp(*pivot->key, *hi))) {
+		pivot = (lo && !cmp(*lo, *pivot->key)) ? pivot->right : pivot->left;
+	}
+
+	const T& key = *pivot->key;
+	diff(o, lo, &key, out);
+	if (!o.find(key, false)) out.push_back(key);
+	diff(o, &key, hi, out);
+}
+
+// Hash of (lo, hi) is that of keys < hi less that of keys
+// <= lo, shifted down by B^(count <= lo) to start at B^0
+template<class T, class Compare, class Balance, bool Hashed>
+Digest<Hashed> Tree<T, Compare, Balance, Hashed>::rangeDigest(
+	const T* lo, const T* hi) const {
+	Digest<Hashed> upper = hi ? prefixDigest(*hi, false)
+		: root ? static_cast<const Digest<Hashed>&>(*root) : Digest<Hashed>{0, 0, 1};
+	if (!lo) return upper;
+
+	Digest<Hashed> lower = prefixDigest(*lo, true);
+	if (lower.count >= upper.count) return {0, 0, 1};
+	return {upper.count - lower.count,
+		(upper.hash - lower.hash) * Digest<Hashed>::inverse(lower.pw), 1};
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+Digest<Hashed> Tree<T, Compare, Balance, Hashed>::prefixDigest(
+	const T& key, bool orEqual) const {
+	Digest<Hashed> d{0, 0, 1};
+	for (Node* node = root; node; ) {
+		if (orEqual ? !cmp(key, *node->key) : cmp(*node->key, key)) {
+			if (node->left) d.append(*node->left);
+			d.append({1, Digest<Hashed>::mix(std::hash<T>()(*node->key)),
+				Digest<Hashed>::B});
+			node = node->right;
+		}
+		else node = node->left;
+	}
+	return d;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::collect(
+	const T* lo, const T* hi, std::vector<T>& out) const {
+	Node* x = first;
+	if (lo) {
+		x = find(*lo);
+		if (x && !cmp(*lo, *x->key)) x = x->inorderNext(); // x <= lo
+	}
+	for (; x && (!hi || cmp(*x->key, *hi)); x = x->inorderNext()) {
+		out.push_back(*x->key);
+	}
+}
+
 //--------------------Tree Functions--------------------
 
-template<class T, class Compare>
-typename Tree<T, Compare>::Node*
-Tree<T, Compare>::find(const T& key, bool getClosest) const {
-	Node* current = root;
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::find(const T& key, bool getClosest) const {
+	if (index && !getClosest) return index->find(key);
+	return descend(root, key, getClosest);
+}
+
+// Climb from finger to 1st ancestor whose subtree's key range
+// holds key, then descend. Range of x is bounded by ancestors
+// x is left (upper bound) or right (lower bound) descendant of.
+// Bound on finger's side of key already holds: finger is in x
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::findFrom(
+	Node* finger, const T& key, bool getClosest) const {
+	if (!finger) return find(key, getClosest);
+
+	Node* x = finger;
+	bool  up = cmp(*x->key, key); // key is right of finger
+	while (x->parent && !same(key, *x->key)) {
+		Node* P = x->parent;
+		if (up ? (x == P->left	&& cmp(key, *P->key))
+			   : (x == P->right && cmp(*P->key, key))) break;
+		x = P;
+	}
+	return descend(x, key, getClosest);
+}
+
+// Compare key with each Node's copy of its key's lead, not
+// key: 1 load per level, where descend() loads Node, then key
+template<class T, class Compare, class Balance, bool Hashed> template<class K, class Less>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::findLead(const K& key, Less less) const {
+	Node* at = nullptr;
+	for (Node* x = root; x; ) {
+		if (less(key, x->lead)) x = x->left;
+		else {
+			at = x;
+			x  = x->right;
+		}
+	}
+	return at ? at : first;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::descend(
+	Node* current, const T& key, bool getClosest) const {
 	if (current) {
-		while (key != *current->key) {
+		while (true) {
 			if (cmp(key, *current->key)) {
 				if (current->left)  current = current->left;
 				else break;
 			}
-			else {
+			else if (cmp(*current->key, key)) {
 				if (current->right) current = current->right;
 				else break;
 			}
+			else return current; // Neither is less: same key
 		}
 
-		if (key == *current->key || getClosest) return current;
+		if (getClosest) return current;
 	}
 	return nullptr;
 }
 
-template<class T, class Compare> template<typename Iter>
-size_t Tree<T, Compare>::insert(Iter it, Iter end) {
+template<class T, class Compare, class Balance, bool Hashed> template<typename Iter>
+size_t Tree<T, Compare, Balance, Hashed>::insert(Iter it, Iter end) {
 	size_t prevSize = sz;
 	// Iter refers to already created object, so must copy key
 	for (; it != end; it++) insert(*it, false);
 	return sz - prevSize;
 }
 
-template<class T, class Compare>
-size_t Tree<T, Compare>::insert(std::initializer_list<T> keys) {
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::insert(std::initializer_list<T> keys) {
 	size_t prevSize = sz;
-	// init_list is temp object, so can move key
-	for (const T& key : keys) insert(key, true);
+	// init_list's keys are const: moving from them is undefined
+	for (const T& key : keys) insert(key, false);
 	return sz - prevSize;
 }
 
-template<class T, class Compare>
-std::pair<typename Tree<T, Compare>::Node*, bool>
-Tree<T, Compare>::insert(const T& key, bool toMove) {
-	Node* current = find(key);
-
-	if (!current) { // Set root as black (root rule)
-		sz = 1;
-
-		if (toMove) { // Call move or copy constructor
-			 root = new Node((T&&)key, false);
-		}
-		else root = new Node(     key, false);
-		return {root, true};
-	}
+template<class T, class Compare, class Balance, bool Hashed>
+std::pair<typename Tree<T, Compare, Balance, Hashed>::Node*, bool>
+Tree<T, Compare, Balance, Hashed>::insert(const T& key, bool toMove, Node* hint) {
+	Node* current = findFrom(hint, key);
 
 	// Dupl. not allowed. To implement dupl., track
 	// key's freq and changes to freq from and to 0
 	// That said, ADS using RedBlackTree as backend
 	// such as Set are intended to store unique keys
-	if (key == *current->key) return {current, false};
+	if (current && same(key, *current->key)) return {current, false};
 
-	// Add leaf having color red, current as parent
 	Node* added;
 	if (toMove) {
 		 // Call Node move constructor that calls T's move constructor
-		 added = new Node((T&&)key, true, current);
+		 added = new Node((T&&)key);
 	}
 	// Call Node copy constructor that calls T's copy constructor
-	else added = new Node(     key, true, current);
+	else added = new Node(     key);
+	attach(added, current);
+	return {added, true};
+}
 
-	if (cmp(key, *current->key)) {
-		current->left  = added;
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::attach(Node* added, Node* P) {
+	added->left = added->right = nullptr;
+	added->parent = P;
+
+	if (!P) { // Set root as black (root rule)
+		added->isRed = false;
+		root = first = last = added;
+		sz	 = 1;
+		refresh(root);
+		if (index) index->add(root->key, root);
+		return;
+	}
+
+	// Add leaf having color red, P as parent
+	// New leaf is new min (max) if it hangs left (right) of old
+	added->isRed = true;
+	if (cmp(*added->key, *P->key)) {
+		P->left  = added;
+		if (P == first) first = added;
 	}
 	else {
-		current->right = added;
+		P->right = added;
+		if (P == last ) last  = added;
 	}
 
+	if (index) index->add(added->key, added);
+	refreshUp(added); // Rotations below refresh own Nodes
+	Balance::insert(*this, added);
+	sz++;
+	if (relaxStep && !pending.empty()) rebalance(relaxStep);
+}
+
+//--------------------Red-Black Balance--------------------
+
+template<class Tree>
+void RedBlackBalance::insert(Tree& tree, typename Tree::Node* added) {
 	// Adding red child does not break black depth 
 	// rule, but may break red parent rule
-	balanceInsert(added);
-	sz++;
-	return {added, true};
+	if (!tree.relaxed) balanceInsert(tree, added);
+	else if (added->parent->isRed) {
+		// Cap depth: black depth holds while relaxed, so a path
+		// with no red-red is <= 2 log2(n + 1) long. Past that,
+		// fix this path now rather than let lookups walk it
+		size_t depth = 0;
+		for (auto* x = added; x->parent; x = x->parent) depth++;
+		if (depth > 2 * size_t(std::bit_width(tree.size() + 1))) repair(tree, added);
+		else tree.pending.push_back(added);
+	}
+}
+
+// balanceInsert at node needs GP black, ie no violation above
+// node. So 1 walk to root lists violations on path, then fix
+// them topmost first. Fixes above only recolor or rotate Nodes
+// near them, so recheck each; loop if node's own still stands
+// Stale node: nothing to fix
+template<class Tree>
+void RedBlackBalance::repair(Tree& tree, typename Tree::Node* node) {
+	using Node = typename Tree::Node;
+	auto isViolation = [](Node* x) {return x->isRed && x->parent && x->parent->isRed;};
+
+	while (isViolation(node)) {
+		Node*  found[128]; // Bottom up. More: next loop fixes rest
+		size_t count = 0;
+		for (Node* x = node; x->parent && count < 128; x = x->parent) {
+			if (isViolation(x)) found[count++] = x;
+		}
+		while (count) {
+			Node* x = found[--count];
+			if (isViolation(x)) balanceInsert(tree, x);
+		}
+	}
+}
+
+template<class Tree>
+typename Tree::Node* RedBlackBalance::erase(Tree& tree,
+	typename Tree::Node* current, typename Tree::Node* next) {
+	using Node = typename Tree::Node;
+
+	// 1 child: Child is red leaf, as black depth of other
+	// (null) side is 0. Splice child into CRNT's place and
+	// make it black: black depth of its branch is kept
+	if (Node* child = current->left ? current->left : current->right) {
+		tree.splice(current);
+		child->isRed = false;
+	}
+	else balanceErase(tree, current);
+	return next;
 }
 
 // Helper: Restore rule that red Node has black || null childs
-template<class T, class Compare>
-void Tree<T, Compare>::balanceInsert(Node* current) {
+template<class Tree>
+void RedBlackBalance::balanceInsert(Tree& tree, typename Tree::Node* current) {
+	using Node = typename Tree::Node;
 
 	// Loop to resolve *CRNT and P being both red
 	// Natural break on P == root, which is always black
@@ -239,7 +446,7 @@ void Tree<T, Compare>::balanceInsert(Node* current) {
 			U->isRed = P->isRed = false;
 
 			// GP swaps its black with P, U for red
-			if (GP != root) {
+			if (GP != tree.root) {
 				GP->isRed = true;
 				current = GP;
 			}
@@ -350,8 +557,12 @@ void Tree<T, Compare>::balanceInsert(Node* current) {
 					GGP->right = top;
 				}
 			}
-			else root = top;
+			else tree.root = top;
 
+			// Childs before parents: GP, P are under top
+			tree.refresh(GP);
+			tree.refresh(P);
+			tree.refresh(top);
 			break;
 		}
 	}
@@ -359,108 +570,174 @@ void Tree<T, Compare>::balanceInsert(Node* current) {
 
 // Specialize: To avoid risk [it] refers to *this tree (Node*
 // is modified while iterating), iterate over T* key instead
-template<class T, class Compare>
-size_t Tree<T, Compare>::erase(
-	Set<T, Compare>::iterator it, Set<T, Compare>::iterator end) {
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::erase(
+	Set<T, Compare, Balance, Hashed>::iterator it, Set<T, Compare, Balance, Hashed>::iterator end) {
 	size_t prevSize = sz;
 
-	T* curKey = nullptr;
-	if (it.ptr) curKey = it.ptr->key;
-
-	T* endKey = nullptr;
-	if (end.ptr) endKey = end.ptr->key;
-
-	while (curKey && curKey != endKey) {
-		T* scsrKey = nullptr;
-		Node* scsr = find(*curKey)->inorderNext();
-		if (scsr) scsrKey = scsr->key;
-		erase(*curKey);
-		curKey = scsrKey;
+	// Erase relinks Nodes, so end's Node stays put. No search
+	for (Node* node = it.ptr; node && node != end.ptr;) {
+		node = eraseNode(node);
 	}
 
 	return prevSize - sz;
 }
 
-template<class T, class Compare> template<typename Iter>
-size_t Tree<T, Compare>::erase(Iter it, Iter end) {
+template<class T, class Compare, class Balance, bool Hashed> template<typename Iter>
+size_t Tree<T, Compare, Balance, Hashed>::erase(Iter it, Iter end) {
 	size_t prevSize = sz;
 	for (; it != end; it++) erase(*it);
 	return prevSize - sz;
 }
 
-template<class T, class Compare>
-size_t Tree<T, Compare>::erase(std::initializer_list<T> keys) {
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::erase(std::initializer_list<T> keys) {
 	size_t prevSize = sz;
 	for (const T& key : keys) erase(key);
 	return prevSize - sz;
 }
 
-template<class T, class Compare>
-std::pair<typename Tree<T, Compare>::Node*, bool>
-Tree<T, Compare>::erase(const T& key) {
-	Node* current = find(key);
+template<class T, class Compare, class Balance, bool Hashed>
+std::pair<typename Tree<T, Compare, Balance, Hashed>::Node*, bool>
+Tree<T, Compare, Balance, Hashed>::erase(const T& key) {
+	Node* current = index ? index->find(key) : find(key);
 
-	if (!current || key != *current->key) { // If !found
+	if (!current || !same(key, *current->key)) { // If !found
 		return {nullptr, false};
 	}
+	return {eraseNode(current), true};
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::eraseNode(Node* current, bool inIndex) {
+	if (index && inIndex) index->remove(current->key);
+	Node* successor = unlinkNode(current);
+
+	// CRNT is unlinked, so delete only 1 Node*
+	freeNode(current);
+	return successor; // SCRS may be null
+}
 
-	// Erase childless root without need to balance
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node*
+Tree<T, Compare, Balance, Hashed>::unlinkNode(Node* current) {
+	// Relaxed: erase fixup needs Red-Black rules to hold. Fixes
+	// only relink Nodes, so current still holds its key
+	if (!pending.empty()) rebalance();
+
+	// Unlink childless root without need to balance
 	if (sz == 1) {
-		delete root;
-		root = nullptr;
+		root = first = last = nullptr;
 		sz	 = 0;
-		return {nullptr, true};
+		return nullptr;
 	}
 	
-	// If current->right: current to hold SCSR key
-	// Else: SCSR key to be found up current's subtree
 	Node* successor = current->inorderNext();
 
-	if (current->right) {
-		Node* tmp = current;
+	// 2 childs: Swap places of CRNT, SCSR Nodes, keys
+	// staying in own Nodes, to continue to 0|1 child
+	// case with CRNT in SCSR's place, no left child
+	// CRNT's left subtree < CRNT key < SCSR key
+	// SCSR is leftmost thus min of CRNT's right subtree
+	// Order of rest holds, as no key lies between them
+	if (current->left && current->right) {
+		swapNodes(current, successor);
+	}
 
-		// 2 childs: Swap current's key with successor's
-		// Swap *SCRS, *CRNT to point to CRNT, SCRS Node
-		// To continue to 0|1 child case with *CRNT to 
-		// erase *CRNT/SCRS Node or its sole child: as
-		// else SCRS's right child would instead be SCRS)
-		// CRNT's left subtree < CRNT key < SCSR key
-		// SCSR is leftmost thus min of CRNT's right subtree
-		if (current->left) {
-			// current->right != null: successor != null
-			current->swapKey(successor->key);
+	successor = Balance::erase(*this, current, successor);
+	sz--;
+	return successor;
+}
 
-			// To erase: SCRS Node or SCRS Node's child 
-			// (Case: 2 child -> 1 child) passed CRNT's key
-			current = successor;
-		}
-		// Else: *CNRT to swap only with CNRT Node's child
+// 1 walk lists all Nodes in order, and positions of victims,
+// so neither path walks Tree again to find them
+template<class T, class Compare, class Balance, bool Hashed> template<class Pred>
+size_t Tree<T, Compare, Balance, Hashed>::eraseIf(Pred pred) {
+	std::vector<Node*>	nodes;
+	std::vector<size_t> hit;
+	nodes.reserve(sz);
+	for (Node* node = first; node; node = node->inorderNext()) {
+		if (pred(static_cast<const T&>(*node->key))) hit.push_back(nodes.size());
+		nodes.push_back(node);
+	}
+	size_t k = hit.size();
 
-		// To return: CRNT Node holding SCSR's key
-		successor = tmp;
+	// Few: k erases of O(log n) each beat relink of all Nodes.
+	// Erase relinks, never moves keys, so listed Nodes stay
+	if (k * eraseIfRebuild < sz) {
+		for (size_t i : hit) eraseNode(nodes[i]);
+		return k;
 	}
 
-	// 1 child: Move *CRNT to child, swap key with child's
-	if (	!current->left &&  current->right) {
-		current->swapKey(current->right->key);
-		current = current->right;
+	// Many: free victims, relink kept Nodes as balanced Tree
+	size_t kept = 0;
+	for (size_t i = 0, j = 0; i < nodes.size(); i++) {
+		Node* node = nodes[i];
+		if (j < k && hit[j] == i) {
+			if (index) index->remove(node->key);
+			node->left = node->right = nullptr;
+			freeNode(node);
+			j++;
+		}
+		else nodes[kept++] = node;
 	}
-	else if (current->left && !current->right) {
-		current->swapKey(current->left ->key);
-		current = current->left;
+
+	pending.clear();
+	sz	 = kept;
+	root = relink(nodes, 0, sz, nullptr, 0, std::bit_width(sz + 1) - 1);
+	resetEnds();
+	Balance::built(*this);
+	return k;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+T Tree<T, Compare, Balance, Hashed>::popEnd(bool isMax) {
+	Node* end = isMax ? last : first;
+
+	// Index finds slot by key's hash: drop it before key moves
+	if (index) index->remove(end->key);
+	T key(std::move(*end->key)); // Moved-from key freed on erase
+	eraseNode(end, false);
+	return key;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+std::pair<typename Tree<T, Compare, Balance, Hashed>::Node*, bool>
+Tree<T, Compare, Balance, Hashed>::updateKey(Node* node, const T& key, bool toMove) {
+	// Order holds if key stays within neighbors: overwrite
+	Node* prev = node->inorderPrev();
+	Node* next = node->inorderNext();
+	if ((!prev || cmp(*prev->key, key)) && (!next || cmp(key, *next->key))) {
+		if (index) index->remove(node->key); // Hash of key changes
+		if (toMove) *node->key = (T&&)key;
+		else		*node->key = key;
+		node->relead(node->key);
+		if (index) index->add(node->key, node);
+		refreshUp(node);
+		return {node, true};
 	}
 
-	balanceErase(current);
-	// CRNT is childless, so delete only 1 Node*
-	delete current;
-	sz--;
-	return {successor, true}; // SCRS may be null
+	// Key held by other Node: leave Tree as is. Else take node
+	// out, set key, hang it back as new leaf where key falls.
+	// Closest Node is key's neighbor, not node, as key is not
+	// between node's: so it stays, and search resumes from it
+	Node* at = find(key, true); // Closest: index finds only held
+	if (same(key, *at->key)) return {at, false};
+	if (index) index->remove(node->key);
+	unlinkNode(node);
+	if (toMove) *node->key = (T&&)key;
+	else		*node->key = key;
+	node->relead(node->key);
+	attach(node, findFrom(at, key));
+	return {node, true};
 }
 
 // Helper: If trim black depth of any branch, trim depth 
 // of all other. Nullify toErase->parent's ptr to toErase
-template<class T, class Compare>
-void Tree<T, Compare>::balanceErase(Node* toErase) {
+template<class Tree>
+void RedBlackBalance::balanceErase(Tree& tree, typename Tree::Node* toErase) {
+	using Node = typename Tree::Node;
 
 	// Only deleting black Node affects black depth
 	if (!toErase->isRed) {
@@ -469,7 +746,7 @@ void Tree<T, Compare>::balanceErase(Node* toErase) {
 
 		// Don't recurse for double black at P == root
 		// as it applies to every branch equally
-		while (current != root) {
+		while (current != tree.root) {
 			// S != null as it has black depth == to CRNT's
 			Node* S = current->sibling();
 			Node* P = current->parent;
@@ -553,16 +830,20 @@ void Tree<T, Compare>::balanceErase(Node* toErase) {
 				}
 
 				// LINE: Left-Left
-				// Set P as S's child. If S's former
-				// child is non-null S had resolved it
+				// Give S's other child to P (may be
+				// non-null if CRNT is not a leaf)
+				// Set P as S's child
 				// If unset, set new top = S
 				else if (S->left && S->left->isRed) {
 					redNiece = S->left;
 
 					if (!top) top = S;
+					P->left = S->right;
+					if (P->left) {
+						P->left->parent = P;
+					}
 					S->right = P;
 					P->parent = S;
-					P->left = nullptr;
 				}
 			}
 			else {
@@ -595,9 +876,12 @@ void Tree<T, Compare>::balanceErase(Node* toErase) {
 					redNiece = S->right;
 
 					if (!top) top = S;
+					P->right = S->left;
+					if (P->right) {
+						P->right->parent = P;
+					}
 					S->left = P;
 					P->parent = S;
-					P->right = nullptr;
 				}
 			}
 
@@ -610,6 +894,10 @@ void Tree<T, Compare>::balanceErase(Node* toErase) {
 				// to black to keep black depth of 2
 				redNiece->isRed = PWasRed;
 
+				// ANGLE moved S beside P, off toErase's path,
+				// so splice's refresh up from toErase misses it
+				tree.refresh(S);
+
 				// If red S, not redNiece, Case set top,
 				// set redNiece Case's top (ie P->parent)
 				// as child of red S Case's top
@@ -656,17 +944,992 @@ void Tree<T, Compare>::balanceErase(Node* toErase) {
 						GP->right = top;
 					}
 				}
-				else root = top;
+				else tree.root = top;
 			}
 			break;
 		}
 	}
 	
-	//erase() verified toErase != root
-	if (toErase == toErase->parent->left) {
-		toErase->parent->left  = nullptr;
+	// erase() verified toErase != root. Leaf: splice in null
+	tree.splice(toErase);
+}
+
+//--------------------Shape Helpers--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::rotateUp(Node* x) {
+	Node* P  = x->parent;
+	Node* GP = P->parent;
+
+	// x's inner subtree (between x and P) moves to P
+	if (x == P->left) {
+		P->left  = x->right;
+		if (P->left ) P->left ->parent = P;
+		x->right = P;
 	}
 	else {
-		toErase->parent->right = nullptr;
+		P->right = x->left;
+		if (P->right) P->right->parent = P;
+		x->left  = P;
+	}
+	P->parent = x;
+
+	x->parent = GP;
+	if		(!GP)			 root	   = x;
+	else if (P == GP->left) GP->left  = x;
+	else					 GP->right = x;
+
+	refresh(P); // Now x's child
+	refresh(x);
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::splice(Node* node) {
+	// Inorder next of leftmost Node is its parent or in its
+	// right subtree: either way, found before node is gone
+	if (node == first) first = node->inorderNext();
+	if (node == last ) last  = node->inorderPrev();
+
+	Node* child = node->left ? node->left : node->right;
+	Node* P		= node->parent;
+	if (child) child->parent = P;
+
+	if		(!P)			   root	    = child;
+	else if (node == P->left) P->left  = child;
+	else					   P->right = child;
+
+	// node must not delete spliced child
+	node->left = node->right = nullptr;
+	refreshUp(P);
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::swapNodes(Node* a, Node* b) {
+	Node* aP = a->parent, *aL = a->left, *aR = a->right;
+	Node* bP = b->parent, *bL = b->left, *bR = b->right;
+	bool  bIsLeft = b == bP->left; // bP != null: b is below a
+
+	// b takes a's place under a's parent
+	b->parent = aP;
+	if		(!aP)			 root	   = b;
+	else if (a == aP->left) aP->left  = b;
+	else					 aP->right = b;
+
+	// a takes b's childs
+	a->left = bL; a->right = bR;
+	if (bL) bL->parent = a;
+	if (bR) bR->parent = a;
+
+	// b takes a's childs; a, if b was one of them
+	if (bP == a) {
+		b->left	 = bIsLeft ? a	: aL;
+		b->right = bIsLeft ? aR : a;
+	}
+	else {
+		b->left = aL; b->right = aR;
+		if (bIsLeft) bP->left  = a;
+		else		 bP->right = a;
+		a->parent = bP;
+	}
+	if (b->left ) b->left ->parent = b;
+	if (b->right) b->right->parent = b;
+
+	// Color, rank belong to place. Digest: erase refreshes
+	// path from a's new place up, through b
+	std::swap(a->isRed, b->isRed);
+	std::swap(a->rank,  b->rank );
+	std::swap(static_cast<Digest<Hashed>&>(*a), static_cast<Digest<Hashed>&>(*b));
+	std::swap(static_cast<Counter&>(*a), static_cast<Counter&>(*b));
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::refresh(Node* node) {
+	if constexpr (Hashed) {
+		Digest<true> d{0, 0, 1};
+		if (node->left) d.append(*node->left);
+		d.append({1, Digest<true>::mix(std::hash<T>()(*node->key)),
+			Digest<true>::B});
+		if (node->right) d.append(*node->right);
+		static_cast<Digest<true>&>(*node) = d;
+	}
+	else if constexpr (Balance::counted) {
+		node->count = 1 + (node->left  ? node->left ->count : 0)
+						+ (node->right ? node->right->count : 0);
+	}
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::refreshUp(Node* node) {
+	if constexpr (Hashed || Balance::counted) {
+		for (; node; node = node->parent) refresh(node);
+	}
+}
+
+//--------------------Staging Buffer--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::stage(const T& key, bool toInsert) {
+	countStaged(key, toInsert);
+	staged.emplace_back(key, toInsert);
+	if (staged.size() >= stageMax) flush();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::stage(T&& key, bool toInsert) {
+	countStaged(key, toInsert);
+	staged.emplace_back((T&&)key, toInsert);
+	if (staged.size() >= stageMax) flush();
+}
+
+// Unsorted tail is scanned newest first. Once it passes ~sqrt
+// of sorted ops (64 at least), sort it in: O(n) merge per
+// sqrt(n) ops staged, so scan and merge cost alike. Sort is
+// here, not in stagedOp, so that lookups only read buffer
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::countStaged(const T& key, bool toInsert) {
+	size_t tailMax = std::max<size_t>(64,
+		size_t(1) << (std::bit_width(stagedSorted) + 1) / 2);
+	if (staged.size() - stagedSorted > tailMax) sortStaged();
+	if (!netKnown.load(std::memory_order_relaxed)) return;
+
+	// Held now: per newest staged op, else per Tree
+	int  op		= stagedOp(key);
+	bool isHeld = op ? op > 0 : find(key, false) != nullptr;
+	if (toInsert != isHeld) net += toInsert ? 1 : -1;
+}
+
+// Newest op per key counts, against whether Tree holds key.
+// Tail op is newest if no later tail op has its key; it then
+// overrides sorted op on key, if any. Tail is ~sqrt of rest
+template<class T, class Compare, class Balance, bool Hashed>
+ptrdiff_t Tree<T, Compare, Balance, Hashed>::countNet() const {
+	auto change = [](bool toInsert, bool isHeld) {
+		return toInsert == isHeld ? 0 : toInsert ? 1 : -1;
+	};
+	ptrdiff_t n = 0;
+	for (size_t i = 0; i < stagedSorted; i++) {
+		n += change(staged[i].second, find(staged[i].first, false));
+	}
+
+	auto end = staged.begin() + stagedSorted;
+	for (size_t i = stagedSorted; i < staged.size(); i++) {
+		const T& key   = staged[i].first;
+		bool  isNewest = true;
+		for (size_t j = i + 1; j < staged.size() && isNewest; j++) {
+			isNewest = !same(staged[j].first, key);
+		}
+		if (!isNewest) continue;
+
+		bool isHeld = find(key, false);
+		auto op		= std::partition_point(staged.begin(), end,
+			[&key](const std::pair<T, bool>& x) {return cmp(x.first, key);});
+		if (op != end && same(op->first, key)) n -= change(op->second, isHeld);
+		n += change(staged[i].second, isHeld);
+	}
+	return n;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+int Tree<T, Compare, Balance, Hashed>::stagedOp(const T& key) const {
+	for (size_t i = staged.size(); i-- > stagedSorted;) {
+		if (same(staged[i].first, key)) return staged[i].second ? 1 : -1;
+	}
+	auto end = staged.begin() + stagedSorted;
+	auto op  = std::partition_point(staged.begin(), end,
+		[&key](const std::pair<T, bool>& x) {return cmp(x.first, key);});
+	if (op != end && same(op->first, key)) return op->second ? 1 : -1;
+	return 0;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::sortStaged() {
+	auto byKey = [](const std::pair<T, bool>& a, const std::pair<T, bool>& b) {
+		return cmp(a.first, b.first);
+	};
+
+	// Stable, and merge takes sorted ops first on ties: among
+	// ops on same key, newest stays last
+	auto mid = staged.begin() + stagedSorted;
+	std::stable_sort(mid, staged.end(), byKey);
+	std::inplace_merge(staged.begin(), mid, staged.end(), byKey);
+
+	// Keep only newest op per key
+	size_t n = 0;
+	for (size_t i = 0; i < staged.size(); i++) {
+		if (n && same(staged[n - 1].first, staged[i].first)) {
+			staged[n - 1] = std::move(staged[i]);
+		}
+		else {
+			if (n != i) staged[n] = std::move(staged[i]);
+			n++;
+		}
+	}
+	staged.erase(staged.begin() + n, staged.end());
+	stagedSorted = n;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::flush() {
+	if (staged.empty()) return;
+	sortStaged();
+	size_t n = staged.size();
+
+	// SMALL: n searches from last op's Node, each climbing only
+	// as far as distance in key order to last key needs
+	if (n * std::bit_width(sz) < sz) {
+		Node* finger = nullptr;
+		for (auto& op : staged) {
+			if (op.second) {
+				finger = insert(op.first, true, finger).first;
+			}
+			else if (Node* x = findFrom(finger, op.first, false)) {
+				finger = eraseNode(x); // Holds successor key
+			}
+		}
+		staged.clear(); stagedSorted = 0;
+		net = 0; netKnown = false;
+		return;
+	}
+
+	// LARGE: Merge inorder Nodes with ops, relink in O(sz + n)
+	// Kept keys keep own Nodes, so iterators to them stay valid
+	std::vector<Node*> nodes, gone;
+	nodes.reserve(sz + n);
+
+	Node* node = first;
+	auto  op   = staged.begin();
+	while (node || op != staged.end()) {
+		if (op == staged.end() || (node && cmp(*node->key, op->first))) {
+			nodes.push_back(node);
+			node = node->inorderNext();
+		}
+		else if (!node || cmp(op->first, *node->key)) {
+			if (op->second) {
+				Node* added = new Node((T&&)op->first);
+				if (index) index->add(added->key, added);
+				nodes.push_back(added);
+			}
+			op++;
+		}
+		else { // Same key: insert keeps present Node, erase drops
+			if (op->second) nodes.push_back(node);
+			else			gone .push_back(node);
+			node = node->inorderNext();
+			op++;
+		}
+	}
+	staged.clear(); stagedSorted = 0;
+	net = 0; netKnown = false;
+
+	// Free dropped Nodes only now: walk above climbs thru them
+	for (Node* x : gone) {
+		if (index) index->remove(x->key);
+		x->left = x->right = nullptr;
+		freeNode(x);
+	}
+
+	pending.clear();
+	sz	 = nodes.size();
+	root = relink(nodes, 0, sz, nullptr, 0, std::bit_width(sz + 1) - 1);
+	resetEnds();
+	Balance::built(*this);
+}
+
+//--------------------Split, Join--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::split(Tree& hi) {
+	flush();
+	hi.clear();
+
+	size_t n = sz / 2;
+	if (!index && !hi.index && arenas.empty() && Balance::split(*this, n, hi)) {
+		hi.sz = sz - n;
+		sz	  = n;
+		resetEnds();
+		hi.resetEnds();
+		return;
+	}
+
+	std::vector<T*> keys;
+	release(keys);
+
+	size_t mid = keys.size() / 2;
+	std::vector<T*> upper(keys.begin() + mid, keys.end());
+	keys.erase(keys.begin() + mid, keys.end());
+
+	build(keys);
+	hi.build(upper);
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::join(Tree& hi) {
+	flush();
+	hi.flush();
+
+	// hi's relayout blocks come along with its Nodes
+	if (!index && !hi.index && Balance::join(*this, hi)) {
+		sz += hi.sz;
+		hi.sz = 0;
+		resetEnds();
+		hi.resetEnds();
+		for (Arena& arena : hi.arenas) {
+			arenas.insert(std::upper_bound(arenas.begin(), arenas.end(), arena,
+				[](const Arena& a, const Arena& b) {
+					return std::less<Node*>()(a.begin, b.begin);
+				}), arena);
+		}
+		hi.arenas.clear();
+		return;
+	}
+
+	std::vector<T*> keys;
+	keys.reserve(sz + hi.sz);
+	release(keys);
+	hi.release(keys);
+	build(keys);
+}
+
+//--------------------Relaxed Balance--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::setRelaxed(bool on, size_t perOp) {
+	relaxed	  = on;
+	relaxStep = on ? perOp : 0;
+	if (!on) rebalance();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::rebalance(size_t budget) {
+	for (; budget && !pending.empty(); budget--) {
+		Node* node = pending.front();
+		pending.pop_front();
+		Balance::repair(*this, node);
+	}
+	return pending.size();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::destroy(Node* node) {
+	while (node) {
+		if (Node* l = node->left) { // Rotate l up: node its right
+			node->left = l->right;
+			l->right   = node;
+			node	   = l;
+		}
+		else {
+			Node* r = node->right;
+			node->right = nullptr;
+			freeNode(node); // Childless now: frees key only
+			node = r;
+		}
+	}
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::freeNode(Node* node) {
+	if (!node->inArena) {
+		delete node;
+		return;
+	}
+	node->~Node();
+
+	// Block holding node: last one beginning at or before it
+	auto arena = std::upper_bound(arenas.begin(), arenas.end(), node,
+		[](Node* p, const Arena& a) {return std::less<Node*>()(p, a.begin);}) - 1;
+	if (--arena->live == 0) {
+		std::allocator<Node>().deallocate(arena->begin, arena->size);
+		arenas.erase(arena);
+	}
+}
+
+//--------------------Hash Index--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::setIndexed(bool on) {
+	if (on == bool(index)) return;
+	if (!on) {
+		delete index;
+		index = nullptr;
+		return;
+	}
+	index = new KeyIndex<T, Node>([](const T& key) {
+		return Digest<true>::mix(std::hash<T>()(key));
+	});
+	reindex();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::reindex() {
+	if (!index) return;
+	index->clear();
+	for (Node* node = first; node; node = node->inorderNext()) {
+		index->add(node->key, node);
+	}
+}
+
+//--------------------Relayout--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::height(Node* node) {
+	size_t h = 0;
+	std::vector<std::pair<Node*, size_t>> stack;
+	if (node) stack.push_back({node, 1});
+	while (!stack.empty()) {
+		auto [x, depth] = stack.back();
+		stack.pop_back();
+		h = std::max(h, depth);
+		if (x->left ) stack.push_back({x->left , depth + 1});
+		if (x->right) stack.push_back({x->right, depth + 1});
+	}
+	return h;
+}
+
+// VEB: top = levels - levels / 2 levels, laid out as a tree of
+// their own, then each subtree hanging below them. Recursion
+// only halves levels: depth O(log log n)
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::layout(Node* node, size_t levels,
+	Layout order, std::vector<Node*>& out) const {
+	if (!node || !levels) return;
+
+	// Stack of (Node, depth below node) in preorder
+	std::vector<std::pair<Node*, size_t>> stack{{node, 0}};
+	if (order == Layout::Preorder || levels == 1) {
+		while (!stack.empty()) {
+			auto [x, depth] = stack.back();
+			stack.pop_back();
+			out.push_back(x);
+			if (depth + 1 == levels) continue;
+			if (x->right) stack.push_back({x->right, depth + 1});
+			if (x->left ) stack.push_back({x->left , depth + 1});
+		}
+		return;
+	}
+
+	size_t top = levels - levels / 2;
+	layout(node, top, order, out);
+	while (!stack.empty()) { // Subtrees at depth top, left to right
+		auto [x, depth] = stack.back();
+		stack.pop_back();
+		if (depth == top) {
+			layout(x, levels - top, order, out);
+			continue;
+		}
+		if (x->right) stack.push_back({x->right, depth + 1});
+		if (x->left ) stack.push_back({x->left , depth + 1});
+	}
+}
+
+// Moved Node is marked by null key; its parent field forwards
+// to its copy. Links into moved Nodes follow forwards; Nodes
+// not moved get links to copies. Then free old Nodes
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::relocate(const std::vector<Node*>& nodes) {
+	size_t n = nodes.size();
+	if (!n) return;
+	Node* block = std::allocator<Node>().allocate(n);
+
+	for (size_t i = 0; i < n; i++) {
+		Node* old  = nodes[i];
+		Node* node = new (block + i) Node(old->key, old->isRed, old->parent);
+		node->left	  = old->left;
+		node->right	  = old->right;
+		node->inArena = true;
+		node->copyAux(old);
+	}
+	for (size_t i = 0; i < n; i++) {
+		nodes[i]->key	 = nullptr;
+		nodes[i]->parent = block + i;
+	}
+
+	auto moved = [](Node* x) {return x && !x->key;};
+	for (size_t i = 0; i < n; i++) {
+		Node *node = block + i, *old = nodes[i], *P = node->parent;
+		if		(moved(P))		   node->parent = P->parent;
+		else if (!P)			   root		   = node;
+		else if (P->left == old) P->left	   = node;
+		else					   P->right	   = node;
+
+		for (Node** child : {&node->left, &node->right}) {
+			if		(moved(*child)) *child = (*child)->parent;
+			else if (*child)		(*child)->parent = node;
+		}
+	}
+	if (moved(first)) first = first->parent;
+	if (moved(last )) last	= last ->parent;
+	for (Node*& node : pending) {
+		if (moved(node)) node = node->parent;
+	}
+	if (index) {
+		for (size_t i = 0; i < n; i++) index->relink(block[i].key, block + i);
+	}
+
+	for (Node* old : nodes) { // Unlinked, key moved: frees Node only
+		old->left = old->right = nullptr;
+		freeNode(old);
+	}
+	Arena arena{block, n, n};
+	arenas.insert(std::upper_bound(arenas.begin(), arenas.end(), arena,
+		[](const Arena& a, const Arena& b) {return std::less<Node*>()(a.begin, b.begin);}),
+		arena);
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::relayout(Layout order) {
+	if (!root) return;
+	rebalance(); // Relaxed: VEB levels assume a shallow Tree
+
+	std::vector<Node*> nodes;
+	nodes.reserve(sz);
+	layout(root, order == Layout::VEB ? height(root) : SIZE_MAX, order, nodes);
+	relocate(nodes);
+	setLayoutFrom(nullptr);
+}
+
+// Subtrees of ~budget Nodes lie at depth d = log2(size / budget)
+// Take one at d on path toward layoutFrom; keys < layoutFrom
+// are done, so equal goes right. Next step resumes after its
+// max key, so changes to Tree between steps are fine
+template<class T, class Compare, class Balance, bool Hashed>
+bool Tree<T, Compare, Balance, Hashed>::relayoutStep(size_t budget, Layout order) {
+	if (!root) return true;
+	size_t levels = std::bit_width(budget ? budget : 1);
+	size_t d = std::bit_width(sz) > levels ? std::bit_width(sz) - levels : 0;
+
+	Node* node = root;
+	for (size_t depth = 0; depth < d; depth++) {
+		Node* next = (!layoutFrom || cmp(*layoutFrom, *node->key))
+			? node->left : node->right;
+		if (!next) break;
+		node = next;
+	}
+
+	Node* max = node;
+	while (max->right) max = max->right;
+	Node* after = max->inorderNext();
+
+	std::vector<Node*> nodes;
+	layout(node, order == Layout::VEB ? height(node) : SIZE_MAX, order, nodes);
+	relocate(nodes);
+	if (after) {
+		setLayoutFrom(after->key);
+		return false;
+	}
+
+	// Pass is done: Nodes above depth d, then start anew
+	nodes.clear();
+	layout(root, d, order, nodes);
+	relocate(nodes);
+	setLayoutFrom(nullptr);
+	return true;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+double Tree<T, Compare, Balance, Hashed>::layoutDistance() const {
+	if (sz < 2) return 0;
+	double sum = 0; // Of log2(distance)
+	for (Node* node = first; node; node = node->inorderNext()) {
+		if (!node->parent) continue;
+		auto a = reinterpret_cast<std::uintptr_t>(node);
+		auto b = reinterpret_cast<std::uintptr_t>(node->parent);
+		sum += std::log2(double(a > b ? a - b : b - a));
+	}
+	return std::exp2(sum / double(sz - 1));
+}
+
+//--------------------Bulk Build--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::release(std::vector<T*>& keys) {
+	for (Node* node = min(); node; node = node->inorderNext()) {
+		keys.push_back(node->key);
+		node->key = nullptr;
+	}
+	destroy(root); // Keys detached above, so deletes Nodes only
+	root = first = last = nullptr;
+	sz	 = 0;
+	pending.clear();
+	if (index) index->clear();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::build(const std::vector<T*>& keys) {
+	sz = keys.size();
+
+	// Split at mid: sibling subtrees differ in size by <= 1,
+	// so all levels above redDepth = floor(log2(sz + 1)) are
+	// full. Color partial bottom level red: black depth same
+	size_t redDepth = std::bit_width(sz + 1) - 1;
+	auto keyAt = [&keys](size_t i) {return keys[i];};
+	root = build(keyAt, 0, sz, nullptr, 0, redDepth, 1);
+	resetEnds();
+	Balance::built(*this);
+	reindex();
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+typename Tree<T, Compare, Balance, Hashed>::Node* Tree<T, Compare, Balance, Hashed>::relink(
+	const std::vector<Node*>& nodes, size_t lo, size_t hi,
+	Node* parent, size_t depth, size_t redDepth) {
+	if (lo >= hi) return nullptr;
+
+	size_t mid = lo + (hi - lo) / 2;
+	Node* node = nodes[mid];
+	node->parent = parent;
+	Balance::place(node, depth, redDepth, hi - lo);
+	node->left	= relink(nodes, lo, mid, node, depth + 1, redDepth);
+	node->right = relink(nodes, mid + 1, hi, node, depth + 1, redDepth);
+	refresh(node);
+	return node;
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<typename KeyAt>
+typename Tree<T, Compare, Balance, Hashed>::Node* Tree<T, Compare, Balance, Hashed>::build(
+	const KeyAt& keyAt, size_t lo, size_t hi,
+	Node* parent, size_t depth, size_t redDepth, unsigned threads) {
+	if (lo >= hi) return nullptr;
+
+	size_t mid = lo + (hi - lo) / 2;
+	Node* node = new Node(keyAt(mid), false, parent);
+	Balance::place(node, depth, redDepth, hi - lo);
+
+	// Subtrees share no Node, so each half builds on own thread
+	if (threads > 1) {
+		std::thread left([&] {
+			node->left = build(keyAt, lo, mid,
+				node, depth + 1, redDepth, threads / 2);
+		});
+		node->right = build(keyAt, mid + 1, hi,
+			node, depth + 1, redDepth, threads - threads / 2);
+		left.join();
+	}
+	else {
+		node->left  = build(keyAt, lo, mid,
+			node, depth + 1, redDepth, 1);
+		node->right = build(keyAt, mid + 1, hi,
+			node, depth + 1, redDepth, 1);
+	}
+	refresh(node);
+	return node;
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<typename Iter>
+void Tree<T, Compare, Balance, Hashed>::assignParallel(Iter it, Iter end, unsigned threads) {
+	if (!threads) threads = std::thread::hardware_concurrency();
+	if (!threads) threads = 1;
+
+	clear();
+	std::vector<T> keys(it, end);
+	size_t n = keys.size();
+	if (n < threads * size_t(4096)) threads = 1; // Not worth a thread
+
+	// SORT: Each thread sorts 1 chunk (run)
+	std::vector<size_t> cut(threads + 1);
+	for (unsigned i = 0; i <= threads; i++) cut[i] = n * i / threads;
+
+	auto less = [](const T& a, const T& b) {return cmp(a, b);};
+	std::vector<std::thread> pool;
+	for (unsigned i = 0; i < threads; i++) {
+		pool.emplace_back([&, i] {
+			std::sort(keys.begin() + cut[i], keys.begin() + cut[i + 1], less);
+		});
+	}
+	for (auto& t : pool) t.join();
+	if (threads > 1) mergeParallel(keys, cut);
+
+	// DEDUPE: keys[i] is kept if greater than keys[i - 1]. Each
+	// thread counts kept in own chunk, then writes kept indices
+	// after kept of all chunks before it (prefix sum)
+	std::vector<size_t> kept(threads + 1, 0);
+	auto isKept = [&keys](size_t i) {
+		return i == 0 || cmp(keys[i - 1], keys[i]);
+	};
+	pool.clear();
+	for (unsigned c = 0; c < threads; c++) {
+		pool.emplace_back([&, c] {
+			for (size_t i = cut[c]; i < cut[c + 1]; i++) {
+				kept[c + 1] += isKept(i);
+			}
+		});
+	}
+	for (auto& t : pool) t.join();
+	for (unsigned c = 0; c < threads; c++) kept[c + 1] += kept[c];
+
+	std::vector<size_t> index(kept[threads]);
+	pool.clear();
+	for (unsigned c = 0; c < threads; c++) {
+		pool.emplace_back([&, c] {
+			size_t out = kept[c];
+			for (size_t i = cut[c]; i < cut[c + 1]; i++) {
+				if (isKept(i)) index[out++] = i;
+			}
+		});
+	}
+	for (auto& t : pool) t.join();
+
+	// BUILD: Same shape and colors as build(). Key of each
+	// Node is moved out of keys by the thread building it
+	sz = index.size();
+	size_t redDepth = std::bit_width(sz + 1) - 1;
+	auto keyAt = [&keys, &index](size_t i) {
+		return new T(std::move(keys[index[i]]));
+	};
+	root = build(keyAt, 0, sz, nullptr, 0, redDepth, threads);
+	resetEnds();
+	Balance::built(*this);
+	reindex();
+}
+
+// Merge by regular sampling: runs yield threads - 1 splitters,
+// cutting key space into threads ranges of about n / threads
+// keys each. Thread c gathers range c from every run into own
+// span of a buffer, merges those pieces. All threads work till
+// the end, unlike a merge of runs in pairs, whose last round
+// runs on 1 thread over all n keys
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::mergeParallel(
+	std::vector<T>& keys, const std::vector<size_t>& cut) {
+	size_t	 n		 = keys.size();
+	unsigned threads = unsigned(cut.size() - 1);
+	auto less = [](const T& a, const T& b) {return cmp(a, b);};
+
+	// Sample each run at threads - 1 even steps; splitters are
+	// samples at even steps of all samples sorted
+	std::vector<T> sample;
+	sample.reserve(size_t(threads) * (threads - 1));
+	for (unsigned i = 0; i < threads; i++) {
+		for (unsigned j = 1; j < threads; j++) {
+			sample.push_back(keys[cut[i] + (cut[i + 1] - cut[i]) * j / threads]);
+		}
+	}
+	std::sort(sample.begin(), sample.end(), less);
+
+	// at[i * (threads + 1) + c]: start in run i of range c.
+	// from[c]: start of range c in merged order
+	std::vector<size_t> at(size_t(threads) * (threads + 1));
+	std::vector<size_t> from(threads + 1, 0);
+	for (unsigned i = 0; i < threads; i++) {
+		size_t* row = &at[size_t(i) * (threads + 1)];
+		row[0]		 = cut[i];
+		row[threads] = cut[i + 1];
+		for (unsigned c = 1; c < threads; c++) {
+			const T& splitter = sample[size_t(c) * (threads - 1) - 1];
+			row[c] = std::lower_bound(keys.begin() + row[c - 1],
+				keys.begin() + cut[i + 1], splitter, less) - keys.begin();
+		}
+		for (unsigned c = 0; c < threads; c++) from[c + 1] += row[c + 1] - row[c];
+	}
+	for (unsigned c = 0; c < threads; c++) from[c + 1] += from[c];
+
+	// Raw buffer: T need not be default constructible
+	std::allocator<T> alloc;
+	T* out = alloc.allocate(n);
+	std::vector<std::thread> pool;
+	for (unsigned c = 0; c < threads; c++) {
+		pool.emplace_back([&, c] {
+			// Gather pieces, then merge adjacent ones in pairs
+			std::vector<size_t> piece(1, from[c]);
+			T* to = out + from[c];
+			for (unsigned i = 0; i < threads; i++) {
+				const size_t* row = &at[size_t(i) * (threads + 1)];
+				to = std::uninitialized_move(keys.begin() + row[c],
+					keys.begin() + row[c + 1], to);
+				piece.push_back(to - out);
+			}
+			for (size_t width = 1; width < threads; width *= 2) {
+				for (size_t i = 0; i + width < threads; i += 2 * width) {
+					std::inplace_merge(out + piece[i], out + piece[i + width],
+						out + piece[std::min(i + 2 * width, size_t(threads))], less);
+				}
+			}
+		});
+	}
+	for (auto& t : pool) t.join();
+
+	// Move back only once all gathered: spans overlap others' runs
+	pool.clear();
+	for (unsigned c = 0; c < threads; c++) {
+		pool.emplace_back([&, c] {
+			std::move(out + from[c], out + from[c + 1], keys.begin() + from[c]);
+			std::destroy(out + from[c], out + from[c + 1]);
+		});
+	}
+	for (auto& t : pool) t.join();
+	alloc.deallocate(out, n);
+}
+
+//--------------------Parallel Traversal--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+void Tree<T, Compare, Balance, Hashed>::cutTasks(Node* node, size_t depth, size_t maxDepth,
+	const T* lo, const T* hi,
+	std::vector<std::pair<Node*, bool>>& tasks) const {
+	if (!node) return;
+	if (depth == maxDepth) {
+		tasks.push_back({node, true});
+		return;
+	}
+
+	// Skip side wholly out of [lo, hi): node < lo means node
+	// and its left subtree < lo; node >= hi, so is right one
+	if (lo && cmp(*node->key, *lo)) {
+		cutTasks(node->right, depth + 1, maxDepth, lo, hi, tasks);
+	}
+	else if (hi && !cmp(*node->key, *hi)) {
+		cutTasks(node->left,  depth + 1, maxDepth, lo, hi, tasks);
+	}
+	else {
+		cutTasks(node->left,  depth + 1, maxDepth, lo, hi, tasks);
+		tasks.push_back({node, false});
+		cutTasks(node->right, depth + 1, maxDepth, lo, hi, tasks);
+	}
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+std::vector<std::pair<typename Tree<T, Compare, Balance, Hashed>::Node*, bool>>
+Tree<T, Compare, Balance, Hashed>::tasksFor(unsigned threads,
+	const T* lo, const T* hi) const {
+	if (!threads) threads = std::thread::hardware_concurrency();
+	if (!threads) threads = 1;
+
+	// Red-Black: each level above black depth is full, so
+	// depth of bit_width(threads) + 3 gives >= 16 tasks/thread
+	std::vector<std::pair<Node*, bool>> tasks;
+	cutTasks(root, 0, std::bit_width(threads) + 3, lo, hi, tasks);
+	return tasks;
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<class Work>
+void Tree<T, Compare, Balance, Hashed>::parallelTasks(unsigned threads,
+	const std::vector<std::pair<Node*, bool>>& tasks, const Work& work) const {
+	if (!threads) threads = std::thread::hardware_concurrency();
+	if (!threads) threads = 1;
+
+	std::atomic<size_t> next(0);
+	auto claim = [&] {
+		for (size_t i; (i = next.fetch_add(1)) < tasks.size();) {
+			work(i, tasks[i]);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads && i < tasks.size(); i++) {
+		pool.emplace_back(claim);
+	}
+	claim(); // Calling thread works too
+	for (auto& t : pool) t.join();
+}
+
+// Stack-based inorder: no inorderNext() climb back to parents
+template<class T, class Compare, class Balance, bool Hashed> template<class Fn>
+size_t Tree<T, Compare, Balance, Hashed>::visit(Node* node,
+	const T* lo, const T* hi, Fn& fn, size_t limit) const {
+	// Stack holds at most height Nodes: allocate once
+	std::vector<Node*> stack;
+	stack.reserve(2 * std::bit_width(sz) + 2);
+
+	size_t count = 0;
+	while ((node || !stack.empty()) && count < limit) {
+		while (node) {
+			// node < lo: skip node and its left subtree
+			if (lo && cmp(*node->key, *lo)) {
+				node = node->right;
+				continue;
+			}
+			stack.push_back(node);
+			node = node->left;
+		}
+		if (stack.empty()) break; // Right spine ran out < lo
+
+		node = stack.back(); stack.pop_back();
+
+		if (hi && !cmp(*node->key, *hi)) break; // Rest are >= hi
+
+		// Load next Nodes while fn runs: right subtree is next
+		// to descend; else stack's top holds next key
+		if		(node->right)	 REDBLACK_PREFETCH(node->right);
+		else if (!stack.empty()) REDBLACK_PREFETCH(stack.back()->key);
+		fn(*node->key);
+		count++;
+		node = node->right;
+	}
+	return count;
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<class Fn>
+size_t Tree<T, Compare, Balance, Hashed>::scan(
+	const T* lo, const T* hi, Fn fn, size_t limit) const {
+	return visit(root, lo, hi, fn, limit);
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<class Fn>
+void Tree<T, Compare, Balance, Hashed>::parallelForEach(Fn fn, unsigned threads,
+	const T* lo, const T* hi) const {
+	parallelTasks(threads, tasksFor(threads, lo, hi),
+		[&](size_t, const std::pair<Node*, bool>& task) {
+			if (task.second) visit(task.first, lo, hi, fn);
+			else			 fn(*task.first->key);
+		});
+}
+
+template<class T, class Compare, class Balance, bool Hashed> template<class R, class Reduce, class Map>
+R Tree<T, Compare, Balance, Hashed>::parallelReduce(R init, Reduce reduce, Map map,
+	unsigned threads, const T* lo, const T* hi) const {
+	// Partial of each task, combined in task (key) order after
+	auto tasks = tasksFor(threads, lo, hi);
+	std::vector<std::optional<R>> partials(tasks.size());
+
+	parallelTasks(threads, tasks,
+		[&](size_t i, const std::pair<Node*, bool>& task) {
+			std::optional<R>& acc = partials[i];
+			auto fold = [&](const T& key) {
+				if (acc) acc = reduce(std::move(*acc), map(key));
+				else	 acc.emplace(map(key));
+			};
+			if (task.second) visit(task.first, lo, hi, fold);
+			else			 fold(*task.first->key);
+		});
+
+	for (auto& partial : partials) {
+		if (partial) init = reduce(std::move(init), std::move(*partial));
+	}
+	return init;
+}
+
+//--------------------Validation--------------------
+
+template<class T, class Compare, class Balance, bool Hashed>
+bool Tree<T, Compare, Balance, Hashed>::valid() const {
+	if (!root) return sz == 0;
+	if (!Balance::checkRoot(root)) return false;
+
+	// Violation still pending: fail before recursion into what
+	// may be a deep Tree
+	for (const Node* node : pending) {
+		if (node->isRed && node->parent->isRed) return false;
+	}
+
+	size_t count = 0;
+	return valid(root, nullptr, nullptr, nullptr, count) && count == sz;
+}
+
+template<class T, class Compare, class Balance, bool Hashed>
+size_t Tree<T, Compare, Balance, Hashed>::valid(const Node* node, const Node* parent,
+	const T* lo, const T* hi, size_t& count) const {
+	if (!node) return 1;
+	if (node->parent != parent) return 0;
+	count++;
+
+	// Key within (lo, hi): bounds set by ancestors' keys
+	if (lo && !cmp(*lo, *node->key)) return 0;
+	if (hi && !cmp(*node->key, *hi)) return 0;
+
+	size_t before = count;
+	size_t lDepth = valid(node->left,  node, lo, node->key, count);
+	size_t rDepth = valid(node->right, node, node->key, hi, count);
+	if constexpr (Hashed || Balance::counted) {
+		if (node->count != count - before + 1) return 0;
 	}
+	return Balance::check(node, lDepth, rDepth);
 }
\ No newline at end of file
@@ -0,0 +1,358 @@
+#pragma once
+#include "RedBlack.h"
+#include <memory>		// For unique_ptr to Shard, as mutex can't move
+#include <mutex>
+#include <shared_mutex>	// Readers share, writers own, per Shard
+#include <optional>		// For lower_bound's copy of key, and ranges
+#include <atomic>		// For Directory published without lock
+#include <thread>		// For yield while readers drain
+
+namespace RedBlack  {
+
+// Set for many threads: key space is cut into ranges (Shards),
+// each a Tree with own lock, so writers to different ranges
+// don't contend. Shard over maxShard keys splits in half; one
+// under maxShard / 8 joins neighbor. So boundaries follow skew
+//
+// No lock is shared by all ops: Shards are found through a
+// Directory read without lock. Each Shard holds own range,
+// changed under own lock; op checks it once locked, and if
+// a split or join moved key since, reads Directory again.
+// Replaced Directory is freed once readers that may hold it
+// are done: each reads it in an epoch, counted per thread
+//
+// Keys are returned by copy: Node* may not outlive the lock.
+// Ordered ops (for_each, scan) lock one Shard at a time, so
+// each Shard is seen consistent, not the whole Set at once
+template<class T, class Compare = std::less<T>,
+	class Balance = RedBlackBalance>
+class ShardedSet {
+	struct Shard {
+		Tree<T, Compare, Balance> tree;
+		mutable std::shared_mutex lock;
+
+		// Under lock: keys in [lo, hi); none: unbounded. Retired
+		// by join, until split reuses it
+		std::optional<T> lo, hi;
+		bool			 retired = false;
+
+		// Re: true if key (none: min of all) belongs here
+		bool holds(const std::optional<T>& key) const {
+			if (retired) return false;
+			if (!key) return !lo;
+			return (!lo || !cmp(*key, *lo)) && (!hi || cmp(*key, *hi));
+		}
+	};
+
+	// Immutable once published. shards[i] holds keys in
+	// [bounds[i - 1], bounds[i]), bounds.size() == shards.size() - 1
+	struct Directory {
+		std::vector<Shard*> shards;
+		std::vector<T>		bounds;
+
+		// Re: Shard whose range held key (none: first Shard)
+		Shard* locate(const std::optional<T>& key) const {
+			if (!key) return shards[0];
+			return shards[std::upper_bound(bounds.begin(), bounds.end(),
+				*key, cmp) - bounds.begin()];
+		}
+	};
+
+	std::atomic<const Directory*> directory;
+
+	// Readers of Directory, per parity of epoch they began in.
+	// Striped by thread, so ops on different cores don't write
+	// the same counter. publish() flips epoch, then waits for
+	// readers of the old parity: only they may hold old one
+	struct alignas(64) Stripe {std::atomic<size_t> readers[2] = {0, 0};};
+	static constexpr size_t			stripes = 64;
+	mutable Stripe					reading[stripes];
+	std::atomic<unsigned>			epoch{0};
+
+	// All Shards, retired ones too, as readers may still lock
+	// them. Held by reshaping, which only split, join, clear take
+	std::vector<std::unique_ptr<Shard>> pool;
+	std::mutex							reshaping;
+	size_t								maxShard;
+	inline static Compare				cmp = Compare();
+
+	// Re: Shard whose range held key in current Directory
+	//	   (none: first Shard). Its lock is not taken
+	Shard* locate(const std::optional<T>& key) const;
+
+	// Do: fn(shard) under own (Lock: unique) or shared lock on
+	//	   Shard holding key. Re: fn's result
+	template<class Lock, class Fn>
+	auto atShard(const T& key, Fn fn) const;
+
+	// Do: fn(shard, from) on Shards in key order, from one
+	//	   holding from (none: first), each under shared lock
+	//	   Stop once fn returns false or last Shard is done
+	template<class Fn>
+	void walk(std::optional<T> from, Fn fn) const;
+
+	// Do: Publish Directory of shards, bounds, and free old one
+	//	   once no reader holds it. Caller holds reshaping
+	void publish(std::vector<Shard*>&& shards, std::vector<T>&& bounds);
+
+	// Do: Split or join Shard holding key if still out of range
+	void reshape(const T& key);
+
+public:
+	explicit ShardedSet(size_t maxShard = 1 << 16):
+		maxShard(maxShard < 2 ? 2 : maxShard) {
+		pool.emplace_back(new Shard());
+		directory.store(new Directory{{pool[0].get()}, {}});
+	}
+	~ShardedSet() {delete directory.load();}
+
+	ShardedSet(const ShardedSet&)			 = delete;
+	ShardedSet& operator=(const ShardedSet&) = delete;
+
+	//--------------------Modifiers--------------------
+
+	// Re: true if key was not already present
+	bool insert(const T& key);
+
+	// Re: true if key was found
+	bool erase (const T& key);
+
+	void clear();
+
+	//--------------------Operations--------------------
+
+	bool count(const T& key) const {
+		return atShard<std::shared_lock<std::shared_mutex>>(key,
+			[&key](const Shard& shard) {return bool(shard.tree.find(key, false));});
+	}
+
+	// Re: Copy of min(x) >= key, across Shards. Empty if none
+	std::optional<T> lower_bound(const T& key) const;
+
+	// Do: Call fn(key) on keys in [lo, hi) in order
+	// Re: Count of keys visited
+	template<class Fn>
+	size_t scan(const T& lo, const T& hi, Fn fn) const;
+
+	// Do: Call fn(key) on every key in order
+	template<class Fn>
+	void for_each(Fn fn) const;
+
+	//--------------------Observers--------------------
+
+	size_t size() const;
+	size_t shard_count() const {
+		return directory.load(std::memory_order_acquire)->shards.size();
+	}
+};
+
+// Directory may be stale, but Shard's own range is not: if it
+// no longer holds key, a reshape came between; read anew
+template<class T, class Compare, class Balance> template<class Lock, class Fn>
+auto ShardedSet<T, Compare, Balance>::atShard(const T& key, Fn fn) const {
+	for (;;) {
+		Shard& shard = *locate(key);
+		Lock hold(shard.lock);
+		if (shard.holds(key)) return fn(shard);
+	}
+}
+
+template<class T, class Compare, class Balance> template<class Fn>
+void ShardedSet<T, Compare, Balance>::walk(std::optional<T> from, Fn fn) const {
+	for (;;) {
+		const Shard& shard = *locate(from);
+		std::shared_lock<std::shared_mutex> read(shard.lock);
+		if (!shard.holds(from)) continue;
+
+		if (!fn(shard, from) || !shard.hi) return;
+		from = *shard.hi; // Next Shard begins at this one's end
+	}
+}
+
+// Epoch is checked again once counted: if publish() flipped
+// it between, it may not have waited for this reader. Retry
+// in new epoch. Shards are never freed, so they outlive it
+template<class T, class Compare, class Balance>
+typename ShardedSet<T, Compare, Balance>::Shard*
+ShardedSet<T, Compare, Balance>::locate(const std::optional<T>& key) const {
+	static thread_local const size_t stripe =
+		std::hash<std::thread::id>()(std::this_thread::get_id()) % stripes;
+	std::atomic<size_t>* in;
+	for (;;) {
+		unsigned at = epoch.load();
+		in = &reading[stripe].readers[at & 1];
+		in->fetch_add(1);
+		if (epoch.load() == at) break;
+		in->fetch_sub(1);
+	}
+	Shard* shard = directory.load()->locate(key);
+	in->fetch_sub(1, std::memory_order_release);
+	return shard;
+}
+
+// Reader that counted itself before flip may hold prev: wait
+// for it. One counted after reads directory after the store,
+// so holds new one. Only prev is freed: readers of the epoch
+// before were drained by last publish()
+template<class T, class Compare, class Balance>
+void ShardedSet<T, Compare, Balance>::publish(
+	std::vector<Shard*>&& shards, std::vector<T>&& bounds) {
+	const Directory* prev = directory.load(std::memory_order_relaxed);
+	directory.store(new Directory{std::move(shards), std::move(bounds)});
+	unsigned at = epoch.fetch_add(1);
+	for (Stripe& stripe : reading) {
+		while (stripe.readers[at & 1].load()) std::this_thread::yield();
+	}
+	delete prev;
+}
+
+template<class T, class Compare, class Balance>
+bool ShardedSet<T, Compare, Balance>::insert(const T& key) {
+	auto [added, shardSz] = atShard<std::unique_lock<std::shared_mutex>>(key,
+		[&key](Shard& shard) {
+			bool isAdded = shard.tree.insert(key).second;
+			return std::pair<bool, size_t>(isAdded, shard.tree.size());
+		});
+	if (shardSz > maxShard) reshape(key);
+	return added;
+}
+
+template<class T, class Compare, class Balance>
+bool ShardedSet<T, Compare, Balance>::erase(const T& key) {
+	auto [found, shardSz] = atShard<std::unique_lock<std::shared_mutex>>(key,
+		[&key](Shard& shard) {
+			bool isFound = shard.tree.erase(key).second;
+			return std::pair<bool, size_t>(isFound, shard.tree.size());
+		});
+	if (found && shardSz < maxShard / 8) reshape(key);
+	return found;
+}
+
+// Shards changed are owned, so ops on them wait, then see new
+// ranges. New Directory is published before they are released
+template<class T, class Compare, class Balance>
+void ShardedSet<T, Compare, Balance>::reshape(const T& key) {
+	std::lock_guard<std::mutex> only(reshaping);
+	const Directory& dir = *directory.load(std::memory_order_relaxed);
+	std::vector<Shard*> shards(dir.shards);
+	std::vector<T>		bounds(dir.bounds);
+	size_t i = std::upper_bound(bounds.begin(), bounds.end(), key, cmp)
+		- bounds.begin();
+	Shard& shard = *shards[i];
+	std::unique_lock<std::shared_mutex> own(shard.lock);
+
+	// SPLIT: Upper half to Shard placed after i: retired one if
+	// any, as stale readers check range, not identity
+	if (shard.tree.size() > maxShard) {
+		Shard* upper = nullptr;
+		for (auto& x : pool) if (x->retired) {upper = x.get(); break;}
+		if (!upper) upper = pool.emplace_back(new Shard()).get();
+
+		std::unique_lock<std::shared_mutex> ownUpper(upper->lock);
+		shard.tree.split(upper->tree);
+		upper->lo	   = **upper->tree.min();
+		upper->hi	   = std::move(shard.hi);
+		upper->retired = false;
+		shard.hi	   = upper->lo;
+		bounds.insert(bounds.begin() + i, *upper->lo);
+		shards.insert(shards.begin() + i + 1, upper);
+		publish(std::move(shards), std::move(bounds));
+		return;
+	}
+
+	// JOIN: With smaller neighbor, unless it would need split
+	if (shard.tree.size() >= maxShard / 8 || shards.size() == 1) return;
+	own.unlock(); // Relock both in key order
+
+	// Helper: Neighbor's size, under its lock
+	auto sizeOf = [&shards](size_t j) {
+		std::shared_lock<std::shared_mutex> read(shards[j]->lock);
+		return shards[j]->tree.size();
+	};
+	size_t lo = i;
+	if (i == shards.size() - 1 || (i > 0 && sizeOf(i - 1) < sizeOf(i + 1))) {
+		lo = i - 1;
+	}
+	Shard& low = *shards[lo], & high = *shards[lo + 1];
+	std::unique_lock<std::shared_mutex> ownLow(low.lock), ownHigh(high.lock);
+	if (low.tree.size() + high.tree.size() > maxShard / 2) return;
+
+	low.tree.join(high.tree);
+	low.hi		 = std::move(high.hi);
+	high.lo		 = high.hi = std::nullopt;
+	high.retired = true;
+	bounds.erase(bounds.begin() + lo);
+	shards.erase(shards.begin() + lo + 1);
+	publish(std::move(shards), std::move(bounds));
+}
+
+// Rest are emptied, retired 1 at a time; ops on their ranges
+// retry till 1st Shard takes whole range. So no 2 Shards ever
+// hold same key, and an op comes before or after its clear
+template<class T, class Compare, class Balance>
+void ShardedSet<T, Compare, Balance>::clear() {
+	std::lock_guard<std::mutex> only(reshaping);
+	std::vector<Shard*> shards(directory.load(std::memory_order_relaxed)->shards);
+	for (size_t i = 1; i < shards.size(); i++) {
+		std::unique_lock<std::shared_mutex> own(shards[i]->lock);
+		shards[i]->tree.clear();
+		shards[i]->lo = shards[i]->hi = std::nullopt;
+		shards[i]->retired = true;
+	}
+	std::unique_lock<std::shared_mutex> own(shards[0]->lock);
+	shards[0]->tree.clear();
+	shards[0]->hi = std::nullopt;
+	publish({shards[0]}, {});
+}
+
+template<class T, class Compare, class Balance>
+std::optional<T>
+ShardedSet<T, Compare, Balance>::lower_bound(const T& key) const {
+	// If Shard holding key has none >= key, answer is min of
+	// next non-empty Shard, as all its keys are >= its bound
+	std::optional<T> found;
+	walk(key, [&](const Shard& shard, const std::optional<T>& from) {
+		auto* x = shard.tree.find(*from);
+		if (x && cmp(**x, *from)) x = x->inorderNext(); // If x < from
+		if (x) found = **x;
+		return !x;
+	});
+	return found;
+}
+
+template<class T, class Compare, class Balance> template<class Fn>
+size_t ShardedSet<T, Compare, Balance>::scan(
+	const T& lo, const T& hi, Fn fn) const {
+	size_t visited = 0;
+	walk(lo, [&](const Shard& shard, const std::optional<T>& from) {
+		auto* x = shard.tree.find(*from);
+		if (x && cmp(**x, *from)) x = x->inorderNext();
+		for (; x && cmp(**x, hi); x = x->inorderNext()) {
+			fn(**x);
+			visited++;
+		}
+		return !shard.hi || cmp(*shard.hi, hi); // Next Shard < hi
+	});
+	return visited;
+}
+
+template<class T, class Compare, class Balance> template<class Fn>
+void ShardedSet<T, Compare, Balance>::for_each(Fn fn) const {
+	walk(std::nullopt, [&fn](const Shard& shard, const std::optional<T>&) {
+		for (auto* x = shard.tree.min(); x; x = x->inorderNext()) {
+			fn(**x);
+		}
+		return true;
+	});
+}
+
+template<class T, class Compare, class Balance>
+size_t ShardedSet<T, Compare, Balance>::size() const {
+	size_t total = 0;
+	walk(std::nullopt, [&total](const Shard& shard, const std::optional<T>&) {
+		total += shard.tree.size();
+		return true;
+	});
+	return total;
+}
+} // namespace RedBlack closed
@@ -0,0 +1,541 @@
+#pragma once
+#include "RedBlack.h"
+#include <new>			// For placement new into inline slots
+#include <memory>		// For destroy of slots
+#include <stdexcept>	// For logic_error on use of invalid iterator
+
+namespace RedBlack  {
+
+// Set for mostly tiny sets: up to N keys sit sorted in inline
+// slots, no heap at all. Insert of key N + 1 moves keys into a
+// Set (promote); erase down to N / 2 moves them back (demote).
+// Gap between N + 1 and N / 2 keeps a Set hovering near N from
+// moving keys back and forth on every insert, erase
+//
+// Iterators are std::vector's, not Set's. Inline, an iterator
+// is a slot index, so insert and erase that shift keys
+// invalidate all iterators, as do promote, demote, move and
+// swap. Keys stay put while in Set: there, only erase of its key
+// invalidates one. Use of an invalid iterator throws: each keeps
+// count of key moves it was made at
+template<class T, size_t N = 16, class Compare = std::less<T>,
+	class Balance = RedBlackBalance>
+class SmallSet {
+	static_assert(N >= 2, "SmallSet needs N >= 2");
+	using Big = Set<T, Compare, Balance>;
+
+	// Inline: slots[0, n) hold keys in order. Else big holds all
+	alignas(T) unsigned char slots[N * sizeof(T)];
+	size_t n	 = 0;
+	Big*   big	 = nullptr;
+	size_t moves = 0; // Count of ops that moved keys: see iterator
+	inline static Compare cmp = Compare();
+
+		  T* slot(size_t i)		  {return reinterpret_cast<		 T*>(slots) + i;}
+	const T* slot(size_t i) const {return reinterpret_cast<const T*>(slots) + i;}
+
+	// Re: Index of min(key) >= key among inline keys
+	size_t lowerIndex(const T& key) const {
+		return std::lower_bound(slot(0), slot(n), key, cmp) - slot(0);
+	}
+
+	// Do: Move inline keys into new Set (promote) or back
+	void promote();
+	void demote ();
+
+	// Do: Demote if erases in Set brought it down to N / 2
+	void settle() {if (big && big->size() <= N / 2) demote();}
+
+	// Do: Erase inline slot i: shift (i, n) down 1 slot over it
+	void eraseSlot(size_t i) {
+		if (i + 1 < n) moves++;
+		std::move(slot(i + 1), slot(n), slot(i));
+		std::destroy_at(slot(--n));
+	}
+
+	void copyFrom(const SmallSet& src);
+	void moveFrom(SmallSet&& src);
+
+public:
+	// For SmallSet, const_iterator and iterator function identically
+	class iterator {
+		friend SmallSet;
+		const SmallSet*		   set	= nullptr;
+		size_t				   i	= SIZE_MAX; // Inline: slot. end(), rend(): SIZE_MAX
+		typename Big::iterator it;				 // Else: into big
+		size_t				   seen = 0;		 // set->moves when made
+		bool				   isForward = true;
+
+		iterator(const SmallSet* set, size_t i, bool isForward = true):
+			set(set), i(i < set->n ? i : SIZE_MAX), seen(set->moves),
+			isForward(isForward) {}
+		iterator(const SmallSet* set, typename Big::iterator it):
+			set(set), it(it), seen(set->moves), isForward(!it.isReversed()) {}
+
+		// Do: Throw if keys moved since iterator was made
+		void check() const {
+			if (seen != set->moves) throw new std::logic_error(
+				"RedBlack::SmallSet iterator used after insert or erase moved keys");
+		}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using difference_type   = std::ptrdiff_t;
+		using value_type        = const T;
+		using reference         = const T&;
+		using pointer           = const T*;
+
+		iterator() {}
+
+		// reverse_iterator's ++() holds predecessor instead of successor
+		bool isReversed() const { return !isForward; }
+
+		bool operator==(const iterator& o) const {
+			return set->big ? it == o.it : i == o.i;
+		}
+		bool operator!=(const iterator& o) const {return !(*this == o);}
+
+		reference operator *() const {
+			check();
+			if (set->big) return *it;
+			if (i < set->n) return *set->slot(i);
+			throw new std::out_of_range(
+				"Can't dereference out-of-range RedBlack::SmallSet iterator");
+		}
+		pointer   operator->() const {return &(**this);}
+
+		// Re: True if iterator can be dereferenced
+		operator bool() const {return set->big ? bool(it) : i < set->n;}
+
+		// Do: Point iterator to next-higher or next-lower key (--, reversed)
+		iterator& operator++();
+		iterator  operator++(int) {iterator tmp(*this); ++(*this); return tmp;}
+		iterator& operator--();
+		iterator  operator--(int) {iterator tmp(*this); --(*this); return tmp;}
+	};
+
+	iterator begin () const {
+		return big ? iterator(this, big->begin ()) : iterator(this, 0);
+	}
+	iterator end   () const {
+		return big ? iterator(this, big->end   ()) : iterator(this, SIZE_MAX);
+	}
+	iterator rbegin() const {
+		return big ? iterator(this, big->rbegin()) : iterator(this, n - 1, false);
+	}
+	iterator rend  () const {
+		return big ? iterator(this, big->rend  ()) : iterator(this, SIZE_MAX, false);
+	}
+
+	using difference_type = iterator::difference_type;
+	using value_compare   = Compare;
+	using key_compare	  = Compare;
+	using pointer		  = T*;
+	using reference		  = T&;
+	using value_type	  = T;
+	using key_type		  = T;
+
+	SmallSet() {}
+	SmallSet(std::initializer_list<T> keys) {insert(keys);}
+	template<typename Iter>
+	SmallSet(Iter it, Iter end) {insert(it, end);}
+
+	SmallSet(const SmallSet& src) {copyFrom(src);}
+	SmallSet(SmallSet&& src) noexcept {moveFrom((SmallSet&&)src);}
+	SmallSet& operator=(const SmallSet& src) {
+		if (this != &src) {clear(); copyFrom(src);}
+		return *this;
+	}
+	SmallSet& operator=(SmallSet&& src) noexcept {
+		if (this != &src) {clear(); moveFrom((SmallSet&&)src);}
+		return *this;
+	}
+	~SmallSet() {clear();}
+
+	bool operator==(const SmallSet& o) const {
+		return size() == o.size() && std::equal(begin(), end(), o.begin());
+	}
+	bool operator!=(const SmallSet& o) const {return !(*this == o);}
+
+	//--------------------Modifiers--------------------
+
+	// Re: (1) holds * to key (2) == true if key was not present
+	std::pair<iterator, bool> insert(const T& key) {return put(key);}
+	std::pair<iterator, bool> insert(	  T&& key) {return put((T&&)key);}
+
+	// Re: Same as insert(key). Hint unused: inline search spans
+	//	   only N keys
+	iterator insert(iterator, const T& key) {return put(key).first;}
+
+	// Re: Count of inserts of keys not already present
+	template<class Iter>
+	size_t insert(Iter it, Iter end) {
+		size_t added = 0;
+		for (; it != end; it++) added += put(*it).second;
+		return added;
+	}
+	size_t insert(std::initializer_list<T> keys) {
+		return insert(keys.begin(), keys.end());
+	}
+
+	// Re: (1) holds * to key, (2) == True if success
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args&&...args) {
+		return put(T(std::forward<Args>(args)...));
+	}
+
+	// Re: If (2) == true , (1) holds * to key's successor
+	//	   If (2) == false, (1) is end()
+	std::pair<iterator, bool> erase(const T& key);
+
+	// Re: (1) holds its next: successor, or if reversed, predecessor
+	std::pair<iterator, bool> erase(iterator it);
+
+	// Re: Count of keys erased
+	template<class Iter>
+	size_t erase(Iter it, Iter end) {
+		size_t gone = 0;
+		for (; it != end; it++) gone += erase(*it).second;
+		return gone;
+	}
+	size_t erase(std::initializer_list<T> keys) {
+		return erase(keys.begin(), keys.end());
+	}
+	// Range is [*it, *end) in key order. Count first: erase
+	// shifts keys, so end would not hold its key after
+	size_t erase(iterator it, iterator end) {
+		size_t count = 0;
+		for (iterator x = it; x != end; ++x) count++;
+		for (size_t i = 0; i < count; i++) it = erase(it).first;
+		return count;
+	}
+
+	// Do: Erase keys where pred(key) (erase_if), or keep only
+	//	   those (retain). Re: Count of keys erased
+	template<class Pred>
+	size_t erase_if(Pred pred);
+	template<class Pred>
+	size_t retain  (Pred pred) {
+		return erase_if([&pred](const T& key) {return !pred(key);});
+	}
+
+	friend void swap(SmallSet& a, SmallSet& b) noexcept {
+		SmallSet tmp((SmallSet&&)a);
+		a = (SmallSet&&)b;
+		b = (SmallSet&&)tmp;
+	}
+
+	void clear() noexcept;
+
+	//-----------------Priority Queue-----------------
+
+	// Re: Min (front) or max (back) key. Set must not be empty
+	const T& front() const {
+		if (big) return big->front();
+		if (n) return *slot(0);
+		throw new std::out_of_range("front() on empty RedBlack::SmallSet");
+	}
+	const T& back () const {
+		if (big) return big->back();
+		if (n) return *slot(n - 1);
+		throw new std::out_of_range("back() on empty RedBlack::SmallSet");
+	}
+
+	// Do: Erase min (front) or max (back) key
+	// Re: Erased key, moved out. Set must not be empty
+	T pop_front();
+	T pop_back ();
+
+	//--------------------Operations--------------------
+
+	bool	 count	 (const T& key) const {
+		if (big) return big->count(key);
+		size_t i = lowerIndex(key);
+		return i < n && !cmp(key, *slot(i));
+	}
+	bool	 contains(const T& key) const {return count(key);}
+
+	iterator find(const T& key) const {
+		if (big) return iterator(this, big->find(key));
+		size_t i = lowerIndex(key);
+		return iterator(this, i < n && !cmp(key, *slot(i)) ? i : n);
+	}
+	iterator lower_bound(const T& key) const {
+		if (big) return iterator(this, big->lower_bound(key));
+		return iterator(this, lowerIndex(key));
+	}
+	iterator upper_bound(const T& key) const {
+		if (big) return iterator(this, big->upper_bound(key));
+		return iterator(this, size_t(
+			std::upper_bound(slot(0), slot(n), key, cmp) - slot(0)));
+	}
+	std::pair<iterator, iterator>
+		equal_range(const T& key) const {
+		return { lower_bound(key), upper_bound(key) };
+	}
+
+	//--------------------Range Scan--------------------
+
+	// Do: fn(key) on keys in [lo, hi) (or >= lo) in order, up
+	//	   to limit keys. Re: Count of keys visited
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, const T& hi, Fn fn, size_t limit = SIZE_MAX) const {
+		if (big) return big->scan(lo, hi, fn, limit);
+		return scanInline(lo, &hi, fn, limit);
+	}
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, Fn fn, size_t limit = SIZE_MAX) const {
+		if (big) return big->scan(lo, fn, limit);
+		return scanInline(lo, nullptr, fn, limit);
+	}
+
+	// Do: Copy keys in [lo, hi) (or >= lo) in order into out,
+	//	   up to out.size(). Re: Count of keys copied
+	size_t scan(const T& lo, const T& hi, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, hi, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+	size_t scan(const T& lo, std::span<T> out) const {
+		T* at = out.data();
+		return scan(lo, [&at](const T& key) {*at++ = key;}, out.size());
+	}
+
+	// Re: View of keys in [lo, hi): bounds found now
+	std::ranges::subrange<iterator> range(const T& lo, const T& hi) const {
+		static_assert(std::ranges::bidirectional_range<
+			std::ranges::subrange<iterator>>);
+		iterator from = lower_bound(lo);
+		if (!cmp(lo, hi)) return {from, from};
+		return {from, lower_bound(hi)};
+	}
+
+	//--------------------Observers--------------------
+
+	size_t size () const {return big ? big->size() : n;}
+	bool   empty() const {return size() == 0;}
+
+	// Re: true if keys are inline, no Tree allocated
+	bool   isInline() const noexcept {return !big;}
+
+	key_compare   key_comp  () const {return Compare();}
+	value_compare value_comp() const {return Compare();}
+
+private:
+	// Do: Insert key, copied or moved as K is
+	template<class K>
+	std::pair<iterator, bool> put(K&& key);
+
+	template<class Fn>
+	size_t scanInline(const T& lo, const T* hi, Fn& fn, size_t limit) const {
+		size_t seen = 0;
+		for (size_t i = lowerIndex(lo); i < n && seen < limit; i++, seen++) {
+			if (hi && !cmp(*slot(i), *hi)) break;
+			fn(*slot(i));
+		}
+		return seen;
+	}
+};
+
+template<class T, size_t N, class Compare, class Balance>
+typename SmallSet<T, N, Compare, Balance>::iterator&
+SmallSet<T, N, Compare, Balance>::iterator::operator++() {
+	check();
+	if (set->big) {
+		++it;
+		return *this;
+	}
+	if (i >= set->n) {
+		std::string s("Can't increment RedBlack::SmallSet iterator past ");
+		s.append(isForward ? "end()" : "rend()");
+		throw new std::out_of_range(s);
+	}
+	if (isForward) i = i + 1 < set->n ? i + 1 : SIZE_MAX;
+	else		   i = i > 0		  ? i - 1 : SIZE_MAX;
+	return *this;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+typename SmallSet<T, N, Compare, Balance>::iterator&
+SmallSet<T, N, Compare, Balance>::iterator::operator--() {
+	check();
+	if (set->big) {
+		--it;
+		return *this;
+	}
+	if (set->n == 0) {
+		throw new std::out_of_range(
+			"Can't decrement iterator of empty RedBlack::SmallSet");
+	}
+
+	// end(): to max key. rend(): to min key
+	if (i >= set->n) i = isForward ? set->n - 1 : 0;
+	else if (isForward ? i == 0 : i + 1 == set->n) {
+		std::string s("Can't decrement RedBlack::SmallSet iterator past ");
+		s.append(isForward ? "begin()" : "rbegin()");
+		throw new std::out_of_range(s);
+	}
+	else i = isForward ? i - 1 : i + 1;
+	return *this;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+void SmallSet<T, N, Compare, Balance>::promote() {
+	// Set's insert(T&&) moves key into its Node: no copy
+	Big* to = new Big();
+	for (size_t i = 0; i < n; i++) to->insert((T&&)*slot(i));
+	std::destroy(slot(0), slot(n));
+	n	= 0;
+	big = to;
+	moves++;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+void SmallSet<T, N, Compare, Balance>::demote() {
+	// Set's keys are const, but pop_front moves key out of Node
+	Big* from = big;
+	big = nullptr;
+	while (!from->empty()) new (slot(n++)) T(from->pop_front());
+	delete from;
+	moves++;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+void SmallSet<T, N, Compare, Balance>::copyFrom(const SmallSet& src) {
+	if (src.big) big = new Big(*src.big);
+	else {
+		std::uninitialized_copy(src.slot(0), src.slot(src.n), slot(0));
+		n = src.n;
+	}
+}
+
+template<class T, size_t N, class Compare, class Balance>
+void SmallSet<T, N, Compare, Balance>::moveFrom(SmallSet&& src) {
+	if (src.big) {
+		big = src.big;
+		src.big = nullptr;
+		src.moves++;
+	}
+	else {
+		std::uninitialized_move(src.slot(0), src.slot(src.n), slot(0));
+		n = src.n;
+		src.clear();
+	}
+}
+
+template<class T, size_t N, class Compare, class Balance>
+void SmallSet<T, N, Compare, Balance>::clear() noexcept {
+	std::destroy(slot(0), slot(n));
+	n = 0;
+	delete big;
+	big = nullptr;
+	moves++;
+}
+
+template<class T, size_t N, class Compare, class Balance> template<class K>
+std::pair<typename SmallSet<T, N, Compare, Balance>::iterator, bool>
+SmallSet<T, N, Compare, Balance>::put(K&& key) {
+	if (!big) {
+		size_t i = lowerIndex(key);
+		if (i < n && !cmp(key, *slot(i))) return {iterator(this, i), false};
+
+		if (n < N) {
+			// Shift [i, n) up 1 slot: last into raw slot n
+			if (i == n) new (slot(n)) T(std::forward<K>(key));
+			else {
+				new (slot(n)) T(std::move(*slot(n - 1)));
+				std::move_backward(slot(i), slot(n - 1), slot(n));
+				*slot(i) = std::forward<K>(key);
+				moves++;
+			}
+			n++;
+			return {iterator(this, i), true};
+		}
+		promote();
+	}
+	auto x = big->insert(std::forward<K>(key));
+	return {iterator(this, x.first), x.second};
+}
+
+template<class T, size_t N, class Compare, class Balance>
+std::pair<typename SmallSet<T, N, Compare, Balance>::iterator, bool>
+SmallSet<T, N, Compare, Balance>::erase(const T& key) {
+	if (!big) {
+		size_t i = lowerIndex(key);
+		if (i == n || cmp(key, *slot(i))) return {end(), false};
+
+		eraseSlot(i); // Successor now at i
+		return {iterator(this, i), true};
+	}
+
+	auto x = big->erase(key);
+	if (!x.second) return {end(), false};
+	if (big->size() > N / 2) return {iterator(this, x.first), true};
+
+	demote();
+	return {lower_bound(key), true}; // Key is gone: successor
+}
+
+template<class T, size_t N, class Compare, class Balance>
+std::pair<typename SmallSet<T, N, Compare, Balance>::iterator, bool>
+SmallSet<T, N, Compare, Balance>::erase(iterator it) {
+	it.check();
+	if (!big) {
+		if (it.i >= n) return {it, false};
+		size_t i = it.i;
+		eraseSlot(i); // Successor now at i; predecessor stays at i - 1
+		return {iterator(this, it.isForward ? i : i - 1, it.isForward), true};
+	}
+	if (!it.it) return {it, false};
+	if (big->size() > N / 2 + 1) {
+		auto x = big->erase(it.it);
+		return {iterator(this, x.first), x.second};
+	}
+
+	// Demote follows: next lands at slot of key's rank
+	size_t rank = 0;
+	for (auto x = big->begin(); cmp(*x, *it.it); ++x) rank++;
+	big->erase(it.it);
+	demote();
+	return {iterator(this, it.isForward ? rank : rank - 1, it.isForward), true};
+}
+
+template<class T, size_t N, class Compare, class Balance> template<class Pred>
+size_t SmallSet<T, N, Compare, Balance>::erase_if(Pred pred) {
+	if (big) {
+		size_t gone = big->erase_if(pred);
+		settle();
+		return gone;
+	}
+	T* last = std::remove_if(slot(0), slot(n), pred);
+	size_t gone = slot(n) - last;
+	std::destroy(last, slot(n));
+	n -= gone;
+	if (gone) moves++;
+	return gone;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+T SmallSet<T, N, Compare, Balance>::pop_front() {
+	if (big) {
+		T key = big->pop_front();
+		settle();
+		return key;
+	}
+	if (!n) throw new std::out_of_range("pop_front() on empty RedBlack::SmallSet");
+	T key((T&&)*slot(0));
+	eraseSlot(0);
+	return key;
+}
+
+template<class T, size_t N, class Compare, class Balance>
+T SmallSet<T, N, Compare, Balance>::pop_back() {
+	if (big) {
+		T key = big->pop_back();
+		settle();
+		return key;
+	}
+	if (!n) throw new std::out_of_range("pop_back() on empty RedBlack::SmallSet");
+	T key((T&&)*slot(n - 1));
+	std::destroy_at(slot(--n));
+	return key;
+}
+} // namespace RedBlack closed
@@ -0,0 +1,106 @@
+#pragma once
+#include <array>
+#include <algorithm>	// For constexpr sort, lower_bound
+#include <functional>	// For std::less
+#include <utility>		// For pair of equal_range
+#include <iterator>		// For reverse_iterator
+#include <stdexcept>
+
+namespace RedBlack  {
+
+// Set fixed at compile time: keyword sets, opcode tables. Keys
+// are sorted in a constexpr constructor, so a constexpr (or
+// static constexpr) StaticSet costs nothing at startup and may
+// sit in read-only memory. Lookups are binary search over one
+// contiguous array: no Nodes, no heap
+//	constexpr auto ops = make_static_set<std::string_view>(
+//		{"add", "sub", "mul"});
+//	static_assert(ops.count("mul"));
+//
+// T must be a literal type, default constructible. Duplicate
+// keys are an error: at compile time, evaluation fails
+template<class T, size_t N, class Compare = std::less<T>>
+class StaticSet {
+	std::array<T, N> keys{};
+	static constexpr Compare cmp = Compare();
+
+	// Helper: Sort keys. Any 2 equal: throw, which at compile
+	// time makes evaluation fail, so the error shows at build
+	constexpr void sortKeys() {
+		std::sort(keys.begin(), keys.end(), cmp);
+		for (size_t i = 1; i < N; i++) {
+			if (!cmp(keys[i - 1], keys[i])) {
+				throw new std::invalid_argument("Duplicate key in RedBlack::StaticSet");
+			}
+		}
+	}
+
+public:
+	using iterator		 = const T*; // Keys are read-only
+	using value_type	 = T;
+	using key_type		 = T;
+	using key_compare	 = Compare;
+	using value_compare	 = Compare;
+
+	constexpr StaticSet(const T (&init)[N]) {
+		std::copy(init, init + N, keys.begin());
+		sortKeys();
+	}
+	constexpr StaticSet(const std::array<T, N>& init): keys(init) {
+		sortKeys();
+	}
+
+	//--------------------Iterators--------------------
+
+	constexpr iterator begin() const {return keys.data();}
+	constexpr iterator end  () const {return keys.data() + N;}
+	constexpr auto	   rbegin() const {return std::make_reverse_iterator(end  ());}
+	constexpr auto	   rend  () const {return std::make_reverse_iterator(begin());}
+
+	//--------------------Operations--------------------
+
+	// Re: If key is in StaticSet, true; else, false
+	constexpr bool	   count(const T& key) const {
+		iterator it = lower_bound(key);
+		return it != end() && !cmp(key, *it);
+	}
+
+	// Re: If key is in StaticSet, holds * to key; else, end()
+	constexpr iterator find(const T& key) const {
+		iterator it = lower_bound(key);
+		return it != end() && !cmp(key, *it) ? it : end();
+	}
+
+	// Re: min(x) >= key (lower), min(x) > key (upper)
+	constexpr iterator lower_bound(const T& key) const {
+		return std::lower_bound(begin(), end(), key, cmp);
+	}
+	constexpr iterator upper_bound(const T& key) const {
+		return std::upper_bound(begin(), end(), key, cmp);
+	}
+	constexpr std::pair<iterator, iterator> equal_range(const T& key) const {
+		return {lower_bound(key), upper_bound(key)};
+	}
+
+	//--------------------Observers--------------------
+
+	constexpr const T& front() const {return keys.front();}
+	constexpr const T& back () const {return keys.back ();}
+	constexpr size_t   size () const {return N;}
+	constexpr bool	   empty() const {return N == 0;}
+
+	constexpr key_compare	key_comp  () const {return Compare();}
+	constexpr value_compare value_comp() const {return Compare();}
+};
+
+// Deduce N from braced keys: StaticSet s({3, 1, 2})
+template<class T, size_t N>
+StaticSet(const T (&)[N]) -> StaticSet<T, N>;
+
+// Re: StaticSet over keys with Compare given, N deduced
+//	   constexpr auto s = make_static_set<int, std::greater<int>>({1, 2});
+template<class T, class Compare = std::less<T>, size_t N>
+constexpr StaticSet<T, N, Compare> make_static_set(const T (&keys)[N]) {
+	return StaticSet<T, N, Compare>(keys);
+}
+} // namespace RedBlack closed
@@ -0,0 +1,462 @@
+#pragma once
+#include "RedBlack.h"
+#include <istream>
+#include <ostream>
+#include <cstdio>		// For EOF of reads
+#include <chrono>		// For per-op latency on replay
+#include <type_traits>	// To record integral keys raw
+#include <optional>		// For end key of range erase
+
+// Record op stream of a Set to compact binary log, then replay
+// it on any set-like backend, to judge changes on real load:
+//	TraceWriter log(file); TracedSet<int> s; s.trace(&log);
+//	..ops on s..; log.flush();
+//	auto ops = readTrace(in);
+//	report(std::cout, "RedBlack", replay<Set<uint64_t>>(ops));
+//	report(std::cout, "std::set", replay<std::set<uint64_t>>(ops));
+namespace RedBlack  {
+
+enum class TraceOp : uint8_t {Insert, Erase, Find, LowerBound, Scan};
+constexpr size_t traceOpCount = 5;
+
+// key: key's code (raw integral, or hash). length: keys walked
+// by Scan from lower_bound(key); 0 for other ops
+struct TraceRecord {
+	TraceOp  op;
+	uint64_t key;
+	uint64_t length;
+};
+
+// Log: "RBTR", version, flags (bit 0: keys hashed), then per
+// op: op byte, key and (Scan only) length as LEB128 varints.
+// Small raw keys take 1-3 bytes. Not thread-safe: 1 per thread
+class TraceWriter {
+	std::ostream&	  out;
+	std::vector<char> buf;
+	bool			  hashed;
+
+	void varint(uint64_t x) {
+		for (; x >= 0x80; x >>= 7) buf.push_back(char(x | 0x80));
+		buf.push_back(char(x));
+	}
+
+public:
+	// If hashKeys, integral keys are hashed as all others are
+	TraceWriter(std::ostream& out, bool hashKeys = false):
+		out(out), hashed(hashKeys) {
+		buf.reserve(1 << 16);
+		buf.insert(buf.end(), {'R', 'B', 'T', 'R', 1, char(hashKeys)});
+	}
+	TraceWriter(const TraceWriter&)			   = delete;
+	TraceWriter& operator=(const TraceWriter&) = delete;
+	~TraceWriter() {flush();}
+
+	bool hashesKeys() const {return hashed;}
+
+	// Do: Append record. Written to out only on flush or once
+	//	   64 KiB buffered, so ops don't wait on I/O
+	void record(TraceOp op, uint64_t key, uint64_t length = 0) {
+		buf.push_back(char(op));
+		varint(key);
+		if (op == TraceOp::Scan) varint(length);
+		if (buf.size() >= (1 << 16) - 24) flush();
+	}
+
+	void flush() {
+		out.write(buf.data(), std::streamsize(buf.size()));
+		out.flush();
+		buf.clear();
+	}
+};
+
+// Re: Records of log written by TraceWriter, in order
+//	   If hashed, set to true if keys were hashed
+inline std::vector<TraceRecord> readTrace(std::istream& in,
+	bool* hashed = nullptr) {
+	char head[6];
+	if (!in.read(head, 6) || head[0] != 'R' || head[1] != 'B' ||
+		head[2] != 'T' || head[3] != 'R' || head[4] != 1) {
+		throw new std::invalid_argument("Not a RedBlack trace, or newer version");
+	}
+	if (hashed) *hashed = head[5] & 1;
+
+	auto varint = [&in](uint64_t& x) {
+		x = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int c = in.get();
+			if (c == EOF) return false;
+			x |= uint64_t(c & 0x7F) << shift;
+			if (!(c & 0x80)) return true;
+		}
+		return false;
+	};
+
+	std::vector<TraceRecord> ops;
+	int c;
+	while ((c = in.get()) != EOF) {
+		TraceRecord r{TraceOp(c), 0, 0};
+		if (c >= int(traceOpCount) || !varint(r.key) ||
+			(r.op == TraceOp::Scan && !varint(r.length))) {
+			throw new std::invalid_argument("Truncated or corrupt RedBlack trace");
+		}
+		ops.push_back(r);
+	}
+	return ops;
+}
+
+// Set that records ops to a TraceWriter once trace() is set.
+// Untraced, costs 1 null check per op. Holds its Set, not is
+// one: code taking Set& can't be handed it and skip the log.
+// Every op that changes keys is recorded, as Insert or Erase
+// per key, so replay ends in same state. Only lookups listed
+// here are offered, each recorded; observers below search
+// nothing. Loops by iterator are unseen: note_iteration()
+template<class T, class Compare = std::less<T>,
+	class Balance = RedBlackBalance, bool Hashed = false>
+class TracedSet {
+	using Base = Set<T, Compare, Balance, Hashed>;
+	Base		 set;
+	TraceWriter* log = nullptr;
+
+	// Re: Integral key as is, unless log hashes; else hash
+	uint64_t code(const T& key) const {
+		if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+			if (!log->hashesKeys()) return uint64_t(key);
+		}
+		return Digest<true>::mix(std::hash<T>()(key));
+	}
+	void note(TraceOp op, const T& key, uint64_t length = 0) const {
+		if (log) log->record(op, code(key), length);
+	}
+
+public:
+	using iterator	  = typename Base::iterator;
+	using key_type	  = T;
+	using value_type  = T;
+	using key_compare = Compare;
+
+	// Keys given before trace() are not recorded
+	TracedSet() = default;
+	template<class Iter>
+	TracedSet(Iter it, Iter end): set(it, end) {}
+	TracedSet(std::initializer_list<T> keys): set(keys) {}
+
+	// Do: Record ops to log from now on. Null: stop
+	void trace(TraceWriter* log) {this->log = log;}
+
+	//--------------------Observers--------------------
+	// Not recorded: none searches by key
+
+	iterator begin () const {return set.begin ();}
+	iterator end   () const {return set.end   ();}
+	iterator rbegin() const {return set.rbegin();}
+	iterator rend  () const {return set.rend  ();}
+	const T& front () const {return set.front ();}
+	const T& back  () const {return set.back  ();}
+	size_t	 size  () const {return set.size ();}
+	bool	 empty () const {return set.empty();}
+	bool	 valid () const {return set.valid();}
+	Compare	 key_comp() const {return set.key_comp();}
+
+	void buffer(size_t n) {set.buffer(n);}
+	void flush () {set.flush();}
+
+	//--------------------Modifiers--------------------
+
+	std::pair<iterator, bool> insert(const T& key) {
+		note(TraceOp::Insert, key);
+		return set.insert(key);
+	}
+	std::pair<iterator, bool> insert(	  T&& key) {
+		note(TraceOp::Insert, key);
+		return set.insert((T&&)key);
+	}
+	iterator insert(iterator hint, const T& key) {
+		note(TraceOp::Insert, key);
+		return set.insert(hint, key);
+	}
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args&&...args) {
+		return insert(T(std::forward<Args>(args)...));
+	}
+	template<class Iter>
+	size_t insert(Iter it, Iter end) {
+		size_t n = 0;
+		for (; it != end; it++) n += insert(*it).second;
+		return n;
+	}
+	size_t insert(std::initializer_list<T> keys) {
+		return insert(keys.begin(), keys.end());
+	}
+
+	std::pair<iterator, bool> erase(const T& key) {
+		note(TraceOp::Erase, key);
+		return set.erase(key);
+	}
+	std::pair<iterator, bool> erase(iterator it) {
+		if (it != (it.isReversed() ? set.rend() : set.end())) {
+			note(TraceOp::Erase, *it);
+		}
+		return set.erase(it);
+	}
+	template<class Iter>
+	size_t erase(Iter it, Iter end) {
+		size_t n = 0;
+		for (; it != end; it++) n += erase(*it).second;
+		return n;
+	}
+	size_t erase(std::initializer_list<T> keys) {
+		return erase(keys.begin(), keys.end());
+	}
+
+	// Erases [*it, *end) in key order, as Set does, 1 by 1
+	size_t erase(iterator it, iterator end) {
+		if (!log) return set.erase(it, end);
+		if (it == end) return 0;
+
+		// Flush may free Node of either bound: hold keys
+		T from(*it);
+		std::optional<T> to;
+		if (end != set.end()) to.emplace(*end);
+		set.flush();
+
+		size_t n = 0;
+		iterator x = set.lower_bound(from);
+		while (x != set.end() && (!to || set.key_comp()(*x, *to))) {
+			note(TraceOp::Erase, *x);
+			x = set.erase(x).first;
+			n++;
+		}
+		return n;
+	}
+
+	// Recorded as Erase of each key erased
+	template<class Pred>
+	size_t erase_if(Pred pred) {
+		return set.erase_if([this, &pred](const T& key) {
+			bool isErased = pred(key);
+			if (isErased) note(TraceOp::Erase, key);
+			return isErased;
+		});
+	}
+	template<class Pred>
+	size_t retain  (Pred pred) {
+		return erase_if([&pred](const T& key) {return !pred(key);});
+	}
+
+	// Not noexcept, unlike Set's: logging flushes Set to walk
+	// it and appends to log, either of which may throw
+	void clear() {
+		if (log) for (const T& key : set) note(TraceOp::Erase, key);
+		set.clear();
+	}
+
+	T pop_front() {
+		T key = set.pop_front();
+		note(TraceOp::Erase, key);
+		return key;
+	}
+	T pop_back () {
+		T key = set.pop_back();
+		note(TraceOp::Erase, key);
+		return key;
+	}
+
+	// Recorded as Erase of old key, Insert of new, if done
+	std::pair<iterator, bool> update_key(iterator it, const T& key) {
+		uint64_t from = log ? code(*it) : 0, to = log ? code(key) : 0;
+		auto x = set.update_key(it, key);
+		if (log && x.second) {
+			log->record(TraceOp::Erase,	 from);
+			log->record(TraceOp::Insert, to);
+		}
+		return x;
+	}
+	std::pair<iterator, bool> update_key(iterator it, 	   T&& key) {
+		uint64_t from = log ? code(*it) : 0, to = log ? code(key) : 0;
+		auto x = set.update_key(it, (T&&)key);
+		if (log && x.second) {
+			log->record(TraceOp::Erase,	 from);
+			log->record(TraceOp::Insert, to);
+		}
+		return x;
+	}
+
+	// Recorded when deferred: replay applies at once, with
+	// same result, as buffered ops stay exact
+	void defer_insert(const T& key) {
+		note(TraceOp::Insert, key);
+		set.defer_insert(key);
+	}
+	void defer_insert(	   T&& key) {
+		note(TraceOp::Insert, key);
+		set.defer_insert((T&&)key);
+	}
+	void defer_erase (const T& key) {
+		note(TraceOp::Erase, key);
+		set.defer_erase(key);
+	}
+
+	//--------------------Lookups--------------------
+
+	bool	 count(const T& key) const {
+		note(TraceOp::Find, key);
+		return set.count(key);
+	}
+	bool	 contains(const T& key) const {return count(key);}
+	iterator find (const T& key) const {
+		note(TraceOp::Find, key);
+		return set.find(key);
+	}
+	iterator lower_bound(const T& key) const {
+		note(TraceOp::LowerBound, key);
+		return set.lower_bound(key);
+	}
+
+	// Recorded as walk of keys visited from lower_bound(lo)
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, const T& hi, Fn fn, size_t limit = SIZE_MAX) const {
+		size_t n = set.scan(lo, hi, fn, limit);
+		note(TraceOp::Scan, lo, n);
+		return n;
+	}
+	template<class Fn> requires std::invocable<Fn&, const T&>
+	size_t scan(const T& lo, Fn fn, size_t limit = SIZE_MAX) const {
+		size_t n = set.scan(lo, fn, limit);
+		note(TraceOp::Scan, lo, n);
+		return n;
+	}
+
+	size_t scan(const T& lo, const T& hi, std::span<T> out) const {
+		size_t n = set.scan(lo, hi, out);
+		note(TraceOp::Scan, lo, n);
+		return n;
+	}
+	size_t scan(const T& lo, std::span<T> out) const {
+		size_t n = set.scan(lo, out);
+		note(TraceOp::Scan, lo, n);
+		return n;
+	}
+
+	// Do: Record loop by iterator over length keys from
+	//	   lower_bound(from), which it does not search itself
+	void note_iteration(const T& from, size_t length) const {
+		note(TraceOp::Scan, from, length);
+	}
+};
+
+// Re: Count of keys erased, each recorded
+template<class T, class Compare, class Balance, bool Hashed, class Pred>
+size_t erase_if(TracedSet<T, Compare, Balance, Hashed>& set, Pred pred) {
+	return set.erase_if(pred);
+}
+
+//--------------------Replay--------------------
+
+// Latency in ns per op, by percentile
+struct Latency {
+	size_t	 count = 0;
+	uint64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+struct ReplayStats {
+	double	 seconds   = 0; // Untimed pass: ops only
+	double	 opsPerSec = 0;
+	uint64_t checksum  = 0; // Same over backends if they agree
+	Latency	 all;
+	Latency	 byOp[traceOpCount];
+};
+
+// Re: Result of record on set, summed into checksum
+template<class Backend>
+uint64_t replayOp(Backend& set, const TraceRecord& r) {
+	switch (r.op) {
+	case TraceOp::Insert:
+		return set.insert(r.key).second;
+	case TraceOp::Erase:
+		set.erase(r.key);
+		return 0;
+	case TraceOp::Find:
+		return set.find(r.key) != set.end();
+	case TraceOp::LowerBound: {
+		auto it = set.lower_bound(r.key);
+		return it != set.end() ? *it : 0;
+	}
+	case TraceOp::Scan: {
+		uint64_t sum = 0;
+		auto it = set.lower_bound(r.key);
+		for (uint64_t n = 0; n < r.length && it != set.end(); n++, ++it) {
+			sum += *it;
+		}
+		return sum;
+	}
+	}
+	return 0;
+}
+
+// Helper: Percentiles of ns, which is reordered
+inline Latency latencyOf(std::vector<uint64_t>& ns) {
+	Latency l;
+	if (!(l.count = ns.size())) return l;
+	std::sort(ns.begin(), ns.end());
+	auto at = [&ns](double q) {return ns[size_t(q * double(ns.size() - 1))];};
+	l.p50  = at(0.5);
+	l.p90  = at(0.9);
+	l.p99  = at(0.99);
+	l.p999 = at(0.999);
+	l.max  = ns.back();
+	return l;
+}
+
+// Do: Run ops on fresh Backend (std::set-like over uint64_t)
+//	   twice: untimed for throughput, then each op timed for
+//	   latency, as clock reads would skew throughput
+template<class Backend>
+ReplayStats replay(const std::vector<TraceRecord>& ops) {
+	using Clock = std::chrono::steady_clock;
+	ReplayStats stats;
+	{
+		Backend set;
+		auto start = Clock::now();
+		for (const TraceRecord& r : ops) stats.checksum += replayOp(set, r);
+		stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		stats.opsPerSec = stats.seconds > 0 ? double(ops.size()) / stats.seconds : 0;
+	}
+
+	Backend set;
+	std::vector<uint64_t> all, byOp[traceOpCount];
+	all.reserve(ops.size());
+	uint64_t sink = 0;
+	for (const TraceRecord& r : ops) {
+		auto start = Clock::now();
+		sink += replayOp(set, r);
+		uint64_t ns = uint64_t(std::chrono::duration_cast<
+			std::chrono::nanoseconds>(Clock::now() - start).count());
+		all.push_back(ns);
+		byOp[size_t(r.op)].push_back(ns);
+	}
+	assert(sink == stats.checksum && "Backend not deterministic");
+	(void)sink;
+
+	stats.all = latencyOf(all);
+	for (size_t i = 0; i < traceOpCount; i++) stats.byOp[i] = latencyOf(byOp[i]);
+	return stats;
+}
+
+// Do: Print stats as 1 line for all ops, 1 per op type seen
+inline void report(std::ostream& os, const char* name, const ReplayStats& s) {
+	static const char* names[traceOpCount] =
+		{"insert", "erase", "find", "lower_bound", "scan"};
+	auto line = [&os](const char* what, const Latency& l) {
+		os << "  " << what << ": n=" << l.count << " ns p50=" << l.p50
+		   << " p90=" << l.p90 << " p99=" << l.p99 << " p99.9=" << l.p999
+		   << " max=" << l.max << "\n";
+	};
+	os << name << ": " << uint64_t(s.opsPerSec) << " ops/s, "
+	   << s.seconds << " s, checksum " << s.checksum << "\n";
+	line("all", s.all);
+	for (size_t i = 0; i < traceOpCount; i++) {
+		if (s.byOp[i].count) line(names[i], s.byOp[i]);
+	}
+}
+} // namespace RedBlack closed
@@ -0,0 +1,694 @@
+// Benchmarks of Set and its variants, apart from main.cpp:
+//	g++ -std=c++20 -O2 -pthread bench.cpp -o bench
+//	./bench [name ..]	(no name: run all; names as in benches)
+//	./bench replay ops.trace	(replay log of TraceWriter)
+// Times are wall clock of 1 run: run on idle machine
+#include "RedBlack.h"
+#include "Balance.h"
+#include "RangeTree.h"
+#include "ShardedSet.h"
+#include "BucketSet.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace RedBlack;
+using Clock = std::chrono::steady_clock;
+
+// Re: Seconds taken by fn()
+template<class Fn>
+static double timed(Fn fn) {
+	auto start = Clock::now();
+	fn();
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Re: n keys drawn uniformly from [0, range)
+static std::vector<int> randomKeys(size_t n, int range, unsigned seed = 1) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> pick(0, range - 1);
+	std::vector<int> keys(n);
+	for (int& key : keys) key = pick(rng);
+	return keys;
+}
+
+//--------------------Buffered Ingest--------------------
+// insert() per key vs defer_insert() into buffers of a few
+// sizes: random keys into empty Set and into 1M keys held,
+// and near-sorted keys (ascending, jittered, as timestamps)
+
+static void ingest() {
+	const size_t n = 1 << 20;
+	std::vector<int> base = randomKeys(n, 1 << 30, 1);
+	std::vector<int> keys = randomKeys(n, 1 << 30, 2);
+	std::vector<int> near(n);
+	for (size_t i = 0; i < n; i++) near[i] = int(i * 512) + keys[i] % 4096;
+
+	std::printf("ingest: %zu keys, Mops/s\n", n);
+	std::printf("  %-16s %10s %10s %10s\n", "mode", "random", "rand/held", "near/held");
+	for (size_t buffer : {size_t(0), size_t(64), size_t(1024), size_t(1 << 16)}) {
+		double rate[3];
+		for (int run = 0; run < 3; run++) {
+			const std::vector<int>& in = run < 2 ? keys : near;
+			Set<int> s;
+			if (run) s.insert(base.begin(), base.end());
+			s.buffer(buffer ? buffer : 64);
+			double t = timed([&] {
+				if (!buffer) for (int key : in) s.insert(key);
+				else {
+					for (int key : in) s.defer_insert(key);
+					s.flush();
+				}
+			});
+			rate[run] = n / t / 1e6;
+		}
+		char mode[32];
+		if (buffer) std::snprintf(mode, sizeof(mode), "defer, buf %zu", buffer);
+		else		std::snprintf(mode, sizeof(mode), "insert");
+		std::printf("  %-16s %10.2f %10.2f %10.2f\n", mode, rate[0], rate[1], rate[2]);
+	}
+}
+
+//--------------------Sharded Writers--------------------
+// Finds only, then mixed ops (50% find, 25% insert, 25% erase),
+// on 1M keys held, split over 1-64 threads: ShardedSet vs 1 lock
+// around Set (shared_mutex: shared for finds, owned for mixed)
+
+// Do: op(key, kind) per key, keys split evenly over threads
+// Re: Mops/s
+template<class Op>
+static double mixedRate(unsigned threads, const std::vector<int>& keys, Op op) {
+	size_t per = keys.size() / threads;
+	double t = timed([&] {
+		std::vector<std::thread> pool;
+		for (unsigned i = 0; i < threads; i++) {
+			pool.emplace_back([&, i] {
+				for (size_t j = i * per; j < (i + 1) * per; j++) {
+					op(keys[j], unsigned(j * 0x9E3779B1u) >> 30);
+				}
+			});
+		}
+		for (std::thread& thread : pool) thread.join();
+	});
+	return per * threads / t / 1e6;
+}
+
+static void sharded() {
+	const size_t held = 1 << 20, ops = 1 << 22;
+	std::vector<int> base = randomKeys(held, 1 << 22, 3);
+	std::vector<int> keys = randomKeys(ops, 1 << 22, 4);
+
+	std::printf("sharded: %zu ops on %zu keys, Mops/s, cores: %u\n",
+		ops, held, std::thread::hardware_concurrency());
+	std::printf("  %-8s %12s %12s %12s %12s\n", "threads",
+		"find:Sharded", "shared+Set", "mix:Sharded", "owned+Set");
+	for (unsigned threads = 1; threads <= 64; threads *= 2) {
+		ShardedSet<int> shardedSet;
+		for (int key : base) shardedSet.insert(key);
+		double a = mixedRate(threads, keys, [&](int key, unsigned) {
+			shardedSet.count(key);
+		});
+		double b = mixedRate(threads, keys, [&](int key, unsigned kind) {
+			if		(kind < 2)	shardedSet.count (key);
+			else if (kind == 2) shardedSet.insert(key);
+			else				shardedSet.erase (key);
+		});
+
+		Set<int>		  set(base.begin(), base.end());
+		std::shared_mutex lock;
+		double c = mixedRate(threads, keys, [&](int key, unsigned) {
+			std::shared_lock<std::shared_mutex> read(lock);
+			set.count(key);
+		});
+		double d = mixedRate(threads, keys, [&](int key, unsigned kind) {
+			std::unique_lock<std::shared_mutex> hold(lock);
+			if		(kind < 2)	set.count (key);
+			else if (kind == 2) set.insert(key);
+			else				set.erase (key);
+		});
+		std::printf("  %-8u %12.2f %12.2f %12.2f %12.2f\n", threads, a, c, b, d);
+	}
+}
+
+//--------------------Sliding Window--------------------
+// ShardedSet holds a window of 1M keys that slides: each op
+// inserts newest, erases oldest, so Shards split at top, join
+// at bottom. Finders run alongside. RSS must level off once
+// window has moved past its start: replaced Directories freed
+
+// Re: Resident set size in MB, from /proc (0: not on Linux)
+static double residentMB() {
+	double kB = 0;
+	if (FILE* status = std::fopen("/proc/self/status", "r")) {
+		char line[256];
+		while (std::fgets(line, sizeof(line), status)) {
+			if (!std::strncmp(line, "VmRSS:", 6)) kB = std::atof(line + 6);
+		}
+		std::fclose(status);
+	}
+	return kB / 1024;
+}
+
+static void window() {
+	const int held = 1 << 20, steps = 8, perStep = 1 << 20;
+	const unsigned finders = 3;
+	ShardedSet<int> shardedSet(4096);
+	for (int key = 0; key < held; key++) shardedSet.insert(key);
+
+	std::atomic<int>  newest{held};
+	std::atomic<bool> done{false};
+	std::vector<std::thread> pool;
+	for (unsigned i = 0; i < finders; i++) {
+		pool.emplace_back([&, i] {
+			std::mt19937 rng(i);
+			while (!done.load(std::memory_order_relaxed)) {
+				shardedSet.count(newest.load(std::memory_order_relaxed) - int(rng() % held));
+			}
+		});
+	}
+
+	std::printf("window: %d keys held, maxShard 4096, %u finders\n", held, finders);
+	std::printf("  %-12s %8s %8s %8s\n", "insert+erase", "shards", "RSS MB", "Mops/s");
+	double first = 0, last = 0;
+	for (int step = 1; step <= steps; step++) {
+		double t = timed([&] {
+			for (int i = 0; i < perStep; i++) {
+				int key = newest.load(std::memory_order_relaxed);
+				shardedSet.insert(key);
+				shardedSet.erase (key - held);
+				newest.store(key + 1, std::memory_order_relaxed);
+			}
+		});
+		last = residentMB();
+		if (step == 2) first = last; // Window has fully moved
+		std::printf("  %-12d %8zu %8.1f %8.2f\n", step * perStep,
+			shardedSet.shard_count(), last, perStep / t / 1e6);
+	}
+	done = true;
+	for (std::thread& thread : pool) thread.join();
+	std::printf("  RSS %s since step 2 (%.1f -> %.1f MB)\n",
+		last > first * 1.1 + 1 ? "GREW" : "flat", first, last);
+}
+
+//--------------------Parallel Build--------------------
+// Strong scaling: build_parallel of 8M unsorted keys on 1-64
+// threads, vs Set(it, end), which inserts key by key
+
+static void build() {
+	const size_t n = 1 << 23;
+	std::vector<int> keys = randomKeys(n, 1 << 30, 5);
+
+	std::printf("build: %zu unsorted keys, seconds, cores: %u\n",
+		n, std::thread::hardware_concurrency());
+	// Best of 2: 1st run after a large free may pay for heap reuse
+	for (unsigned threads = 1; threads <= 64; threads *= 2) {
+		auto run = [&] {Set<int>::build_parallel(keys.begin(), keys.end(), threads);};
+		char name[32];
+		std::snprintf(name, sizeof(name), "parallel, %u", threads);
+		std::printf("  %-14s %8.2f\n", name, std::min(timed(run), timed(run)));
+	}
+	double t = timed([&] {Set<int> s(keys.begin(), keys.end());});
+	std::printf("  %-14s %8.2f\n", "Set(it, end)", t);
+}
+
+//--------------------Timer Queue--------------------
+// Timer wheel: 100K live timers; per op, 80% expire earliest
+// and rearm it, 20% rearm a random timer (as on I/O). Key:
+// deadline << 20 | timer id. priority_queue can't rearm in
+// place, so it pushes a copy and skips stale ones on pop
+// Then job queue of string keys, hash_index on: pop_front and
+// pop_back move keys out; each is checked against std::set
+
+static void queue() {
+	const uint32_t timers = 100000;
+	const size_t   ops	  = 1 << 21;
+	std::vector<int> draw = randomKeys(ops * 2, 1 << 16, 6);
+	auto key = [](uint64_t deadline, uint32_t id) {return deadline << 20 | id;};
+
+	std::printf("queue: %u timers, %zu ops, Mops/s\n", timers, ops);
+
+	// Set: handles stay valid across erase, so rearm is update_key
+	double tSet = timed([&] {
+		Set<uint64_t> q;
+		std::vector<Set<uint64_t>::iterator> at(timers);
+		for (uint32_t id = 0; id < timers; id++) at[id] = q.insert(key(draw[id], id)).first;
+		uint64_t now = 0;
+		for (size_t i = 0; i < ops; i++) {
+			uint32_t id;
+			if (draw[i] % 5) {
+				uint64_t top = q.front();
+				now = top >> 20;
+				id	= uint32_t(top & 0xFFFFF);
+			}
+			else id = uint32_t(draw[ops + i]) % timers;
+			at[id] = q.update_key(at[id], key(now + 1 + draw[ops + i], id)).first;
+		}
+	});
+
+	double tStd = timed([&] {
+		std::set<uint64_t> q;
+		std::vector<std::set<uint64_t>::iterator> at(timers);
+		for (uint32_t id = 0; id < timers; id++) at[id] = q.insert(key(draw[id], id)).first;
+		uint64_t now = 0;
+		for (size_t i = 0; i < ops; i++) {
+			uint32_t id;
+			if (draw[i] % 5) {
+				uint64_t top = *q.begin();
+				now = top >> 20;
+				id	= uint32_t(top & 0xFFFFF);
+			}
+			else id = uint32_t(draw[ops + i]) % timers;
+			q.erase(at[id]);
+			at[id] = q.insert(key(now + 1 + draw[ops + i], id)).first;
+		}
+	});
+
+	double tHeap = timed([&] {
+		std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> q;
+		std::vector<uint64_t> live(timers); // Current key per timer
+		for (uint32_t id = 0; id < timers; id++) q.push(live[id] = key(draw[id], id));
+		uint64_t now = 0;
+		for (size_t i = 0; i < ops; i++) {
+			uint32_t id;
+			if (draw[i] % 5) {
+				while (q.top() != live[q.top() & 0xFFFFF]) q.pop(); // Stale
+				uint64_t top = q.top();
+				q.pop();
+				now = top >> 20;
+				id	= uint32_t(top & 0xFFFFF);
+			}
+			else id = uint32_t(draw[ops + i]) % timers;
+			q.push(live[id] = key(now + 1 + draw[ops + i], id));
+		}
+	});
+
+	// Keys past small-string size, so a moved-from key is empty
+	auto job = [](uint64_t deadline, uint32_t id) {
+		char name[48];
+		std::snprintf(name, sizeof(name), "job-%012llu-%08u-queued",
+			(unsigned long long)deadline, id);
+		return std::string(name);
+	};
+	size_t mismatched = 0;
+	double tPop = timed([&] {
+		Set<std::string> q;
+		std::set<std::string> ref;
+		q.hash_index();
+		for (uint32_t id = 0; id < timers; id++) {
+			q.insert(job(draw[id], id));
+			ref.insert(job(draw[id], id));
+		}
+		for (size_t i = 0; i < ops; i++) {
+			std::string top = draw[i] % 2 ? q.pop_front() : q.pop_back();
+			auto at = draw[i] % 2 ? ref.begin() : std::prev(ref.end());
+			mismatched += top != *at;
+			ref.erase(at);
+			mismatched += q.count(top); // Index must not find it
+			q.insert(job(draw[ops + i], uint32_t(i)));
+			ref.insert(job(draw[ops + i], uint32_t(i)));
+		}
+		mismatched += !std::equal(q.begin(), q.end(), ref.begin(), ref.end());
+	});
+	if (mismatched) std::printf("  pop_front/back differ from std::set: %zu\n", mismatched);
+
+	std::printf("  %-16s %8.2f\n", "Set, update_key", ops / tSet  / 1e6);
+	std::printf("  %-16s %8.2f\n", "std::set",		  ops / tStd  / 1e6);
+	std::printf("  %-16s %8.2f\n", "priority_queue",  ops / tHeap / 1e6);
+	std::printf("  %-16s %8.2f\n", "Set<string> pop", ops / tPop  / 1e6);
+}
+
+//--------------------Balance Policies--------------------
+// Each Balance, with and without Hashed, on 1M keys held:
+// ops are find with read share, else insert or erase. Then
+// Tree split in half and join back: Treap relinks, rest rebuild
+
+template<class Balance, bool Hashed>
+static double policyRate(const std::vector<int>& base,
+	const std::vector<int>& keys, unsigned readPct) {
+	Set<int, std::less<int>, Balance, Hashed> s(base.begin(), base.end());
+	size_t found = 0;
+	double t = timed([&] {
+		for (size_t i = 0; i < keys.size(); i++) {
+			unsigned kind = unsigned(i * 0x9E3779B1u) % 100;
+			if		(kind < readPct)		   found += s.count(keys[i]);
+			else if ((kind - readPct) % 2 == 0) s.insert(keys[i]);
+			else								s.erase (keys[i]);
+		}
+	});
+	if (found == SIZE_MAX) std::printf("\n"); // Keep finds
+	return keys.size() / t / 1e6;
+}
+
+template<class Balance, bool Hashed>
+static void policyRow(const char* name, const std::vector<int>& base,
+	const std::vector<int>& keys) {
+	std::printf("  %-14s", name);
+	for (unsigned readPct : {100u, 95u, 50u, 10u}) {
+		std::printf(" %9.2f", policyRate<Balance, Hashed>(base, keys, readPct));
+	}
+
+	Tree<int, std::less<int>, Balance, Hashed> lo, hi;
+	for (int key : base) lo.insert(key);
+	const int reps = 8;
+	double t = timed([&] {
+		for (int i = 0; i < reps; i++) {
+			lo.split(hi);
+			lo.join (hi);
+		}
+	});
+	std::printf(" %13.1f\n", t / reps * 1e6);
+}
+
+static void policy() {
+	const size_t held = 1 << 20, ops = 1 << 21;
+	std::vector<int> base = randomKeys(held, 1 << 21, 7);
+	std::vector<int> keys = randomKeys(ops,	 1 << 21, 8);
+
+	std::printf("policy: %zu ops on %zu keys, Mops/s by %% find\n", ops, held);
+	std::printf("  %-14s %9s %9s %9s %9s %13s\n", "balance", "100%", "95%", "50%", "10%",
+		"split+join us");
+	policyRow<RedBlackBalance, false>("RedBlack",	   base, keys);
+	policyRow<RedBlackBalance, true >("RedBlack, hash", base, keys);
+	policyRow<WAVLBalance,	   false>("WAVL",		   base, keys);
+	policyRow<WAVLBalance,	   true >("WAVL, hash",	   base, keys);
+	policyRow<TreapBalance,	   false>("Treap",		   base, keys);
+	policyRow<TreapBalance,	   true >("Treap, hash",   base, keys);
+}
+
+//--------------------Finger Search--------------------
+// Probes of 1M keys held: find from root vs find_from last
+// result, over sequential, clustered (random walk) and random
+// streams. Batch: lower_bound_sorted over stream sorted
+
+static void finger() {
+	const size_t held = 1 << 20, probes = 1 << 21;
+	Set<int> s;
+	std::vector<int> base(held);
+	for (size_t i = 0; i < held; i++) base[i] = int(i * 2);
+	s = Set<int>::build_parallel(base.begin(), base.end(), 1);
+
+	std::vector<int> noise = randomKeys(probes, 1 << 21, 9);
+	std::vector<std::vector<int>> streams(3, std::vector<int>(probes));
+	int walk = int(held);
+	for (size_t i = 0; i < probes; i++) {
+		streams[0][i] = int(i % held * 2);
+		walk = std::clamp(walk + noise[i] % 65 - 32, 0, int(held * 2));
+		streams[1][i] = walk;
+		streams[2][i] = noise[i];
+	}
+
+	std::printf("finger: %zu probes on %zu keys, Mops/s\n", probes, held);
+	std::printf("  %-12s %10s %10s %10s\n", "stream", "find", "find_from", "sorted");
+	const char* names[] = {"sequential", "clustered", "random"};
+	for (int k = 0; k < 3; k++) {
+		const std::vector<int>& stream = streams[k];
+		size_t hits = 0;
+		double a = timed([&] {
+			for (int key : stream) hits += s.find(key) != s.end();
+		});
+		double b = timed([&] {
+			Set<int>::iterator hint = s.end();
+			for (int key : stream) {
+				Set<int>::iterator x = s.find_from(hint, key);
+				if (x != s.end()) {hits++; hint = x;}
+			}
+		});
+		std::vector<int> sorted(stream);
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<Set<int>::iterator> out(probes);
+		double c = timed([&] {s.lower_bound_sorted(sorted.begin(), sorted.end(), out.begin());});
+		if (hits == SIZE_MAX) std::printf("\n"); // Keep finds
+		std::printf("  %-12s %10.2f %10.2f %10.2f\n", names[k],
+			probes / a / 1e6, probes / b / 1e6, probes / c / 1e6);
+	}
+}
+
+//--------------------2D Range Query--------------------
+// Boxes over 1M random points: RangeTree vs Set ordered by
+// (x, y), which bounds x by lower_bound, then filters y key
+// by key. Box sides are share of coordinate range: x, y
+
+struct Point2 {
+	int x, y;
+	bool operator==(const Point2& o) const {return x == o.x && y == o.y;}
+	bool operator!=(const Point2& o) const {return !(*this == o);}
+	struct CMP {
+		bool operator()(const Point2& a, const Point2& b) const {
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		}
+	};
+};
+
+static void range2d() {
+	const size_t n = 1 << 20, queries = 500;
+	const int	 side = 1 << 20;
+	std::vector<int> xs = randomKeys(n, side, 10), ys = randomKeys(n, side, 11);
+	std::vector<Point2> points(n);
+	for (size_t i = 0; i < n; i++) points[i] = {xs[i], ys[i]};
+
+	RangeTree<Point2, Point2::CMP> tree(points.begin(), points.end());
+	Set<Point2, Point2::CMP>	   set (points.begin(), points.end());
+	std::vector<int> at = randomKeys(queries * 2, side, 12);
+
+	std::printf("range2d: %zu boxes over %zu points, us per box\n", queries, n);
+	std::printf("  %-14s %10s %10s %10s\n", "box (x, y)", "RangeTree", "Set+filter", "keys/box");
+	const double shapes[][2] = {{0.001, 0.001}, {0.01, 0.01}, {0.1, 0.01}, {0.1, 0.1}, {0.5, 0.001}};
+	for (const auto& shape : shapes) {
+		int w = int(side * shape[0]), h = int(side * shape[1]);
+		size_t a = 0, b = 0;
+		double tTree = timed([&] {
+			for (size_t q = 0; q < queries; q++) {
+				int x = at[q] % (side - w), y = at[queries + q] % (side - h);
+				a += tree.query(x, x + w, y, y + h, [](const Point2&) {});
+			}
+		});
+		double tSet = timed([&] {
+			for (size_t q = 0; q < queries; q++) {
+				int x = at[q] % (side - w), y = at[queries + q] % (side - h);
+				for (auto it = set.lower_bound({x, INT_MIN}); it != set.end() && it->x <= x + w; ++it) {
+					b += it->y >= y && it->y <= y + h;
+				}
+			}
+		});
+		if (a != b) std::printf("  counts differ: %zu, %zu\n", a, b);
+		char name[32];
+		std::snprintf(name, sizeof(name), "%g, %g", shape[0], shape[1]);
+		std::printf("  %-14s %10.1f %10.1f %10.1f\n", name,
+			tTree / queries * 1e6, tSet / queries * 1e6, double(a) / queries);
+	}
+}
+
+//--------------------Erase If Crossover--------------------
+// erase_if on 1M keys vs erase(it) of each victim after 1
+// walk (as its in-place path does), by share of keys erased,
+// victims random or contiguous. Path: one erase_if takes, by
+// eraseIfRebuild. Crossover is where each-erase passes relink
+
+static void eraseif() {
+	const size_t n = 1 << 20;
+	std::vector<int> keys(n);
+	for (size_t i = 0; i < n; i++) keys[i] = int(i);
+	std::vector<int> noise = randomKeys(n, 1 << 30, 15);
+
+	std::printf("eraseif: %zu keys, ms\n", n);
+	std::printf("  %-8s %10s %10s %10s %10s %8s\n", "erased",
+		"rand each", "rand if", "cont each", "cont if", "path");
+	for (double share : {0.01, 0.05, 0.1, 0.2, 0.3, 0.5, 0.6, 0.7, 0.8, 0.9}) {
+		int cut = int(share * (1 << 30)), last = int(share * n);
+		double t[4];
+		for (int run = 0; run < 3; run++) for (int k = 0; k < 4; k++) {
+			Set<int> s = Set<int>::build_parallel(keys.begin(), keys.end(), 1);
+			auto isVictim = [&](int key) {
+				return k < 2 ? noise[size_t(key)] < cut : key < last;
+			};
+			double took = timed([&] {
+				if (k % 2) s.erase_if(isVictim);
+				else {
+					std::vector<Set<int>::iterator> victims;
+					for (auto it = s.begin(); it != s.end(); ++it) {
+						if (isVictim(*it)) victims.push_back(it);
+					}
+					for (auto it : victims) s.erase(it);
+				}
+			});
+			t[k] = run ? std::min(t[k], took) : took; // Best of 3, interleaved
+		}
+		char name[16];
+		std::snprintf(name, sizeof(name), "%g%%", share * 100);
+		bool isEach = share < 0.5; // Tree's eraseIfRebuild of 2
+		std::printf("  %-8s %10.1f %10.1f %10.1f %10.1f %8s\n", name, t[0] * 1e3,
+			t[1] * 1e3, t[2] * 1e3, t[3] * 1e3, isEach ? "each" : "relink");
+	}
+}
+
+//--------------------Relaxed Latency--------------------
+// Per-insert latency of 1M inserts, eager Red-Black vs relax()
+// with perOp of 1 and 0 (0: rebalance() once at end, its time
+// in rate, not in percentiles). Sorted and random keys. No
+// max: it times allocator reclaiming last Set's Nodes
+
+static void relaxed() {
+	const size_t n = 1 << 20;
+	std::vector<int> sorted(n);
+	for (size_t i = 0; i < n; i++) sorted[i] = int(i);
+	std::vector<int> random = randomKeys(n, 1 << 30, 14);
+	std::vector<double> ns(n);
+
+	std::printf("relaxed: %zu inserts, ns per insert\n", n);
+	std::printf("  %-16s %8s %8s %8s %10s\n", "keys, mode", "p50", "p99", "p99.9", "Mops/s");
+	for (int k = 0; k < 2; k++) {
+		const std::vector<int>& keys = k ? random : sorted;
+		for (int mode = 0; mode < 3; mode++) {
+			Set<int> s;
+			if (mode) s.relax(true, mode == 1 ? 1 : 0);
+			double total = timed([&] {
+				for (size_t i = 0; i < n; i++) {
+					auto start = Clock::now();
+					s.insert(keys[i]);
+					ns[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+				}
+				s.rebalance();
+			});
+			std::sort(ns.begin(), ns.end());
+			char name[32];
+			std::snprintf(name, sizeof(name), "%s, %s", k ? "random" : "sorted",
+				mode == 0 ? "eager" : mode == 1 ? "perOp 1" : "perOp 0");
+			std::printf("  %-16s %8.0f %8.0f %8.0f %10.2f\n", name, ns[n / 2],
+				ns[n * 99 / 100], ns[n * 999 / 1000], n / total / 1e6);
+		}
+	}
+}
+
+//--------------------Buckets Past Cache--------------------
+// BucketSet vs Set from keys that fit in cache to far more
+// than last level cache holds (Set: ~40 B per key, so 32M
+// keys take ~1.3 GB). Random finds, and scans of 1K keys from
+// random starts. Each is built, timed, freed in turn
+
+template<class S>
+static void bucketRow(const char* name, size_t n, const std::vector<int>& probes,
+	const std::vector<int>& keys) {
+	double tBuild = 0, tFind, tScan;
+	size_t hits = 0, seen = 0;
+	{
+		S s;
+		tBuild = timed([&] {
+			if constexpr (requires {S::build_parallel(keys.begin(), keys.end(), 1);}) {
+				s = S::build_parallel(keys.begin(), keys.end(), 1);
+			}
+			else for (int key : keys) s.insert(key);
+		});
+		tFind = timed([&] {for (int key : probes) hits += s.count(key);});
+		tScan = timed([&] {
+			for (size_t q = 0; q < probes.size() / 1024; q++) {
+				seen += s.scan(probes[q], INT_MAX, [](int) {}, 1024);
+			}
+		});
+	}
+	if (hits == SIZE_MAX) std::printf("\n"); // Keep finds
+	std::printf("  %-10s %6zuM %10.2f %10.2f %10.2f\n", name, n >> 20,
+		n / tBuild / 1e6, probes.size() / tFind / 1e6, seen / tScan / 1e6);
+}
+
+static void buckets() {
+	const size_t probeCount = 1 << 21;
+	std::printf("buckets: %zu random finds; scans of 1K keys, Mops/s\n", probeCount);
+	std::printf("  %-10s %7s %10s %10s %10s\n", "set", "keys", "build", "find", "scan");
+	for (size_t n : {size_t(1) << 20, size_t(1) << 23, size_t(1) << 25}) {
+		std::vector<int> keys(n);
+		for (size_t i = 0; i < n; i++) keys[i] = int(i * 2);
+		std::vector<int> probes = randomKeys(probeCount, int(n * 2), 13);
+		bucketRow<Set<int>>		 ("Set",		n, probes, keys);
+		bucketRow<BucketSet<int>>("BucketSet",	n, probes, keys);
+	}
+}
+
+//--------------------Trace Replay--------------------
+// Log given after "replay", run on Set and std::set side by
+// side. None: record 1M ops on a TracedSet first (70% find,
+// 10% each insert, erase, scan of 16) over 64K keys
+
+static const char* traceFile = nullptr;
+
+static void replayTrace() {
+	std::vector<TraceRecord> ops;
+	if (traceFile) {
+		std::ifstream in(traceFile, std::ios::binary);
+		if (!in) {
+			std::printf("replay: can't open %s\n", traceFile);
+			return;
+		}
+		ops = readTrace(in);
+	}
+	else {
+		std::stringstream out;
+		{
+			TraceWriter log(out);
+			TracedSet<int> s;
+			s.trace(&log);
+			std::vector<int> keys = randomKeys(1 << 20, 1 << 16, 14);
+			for (size_t i = 0; i < keys.size(); i++) {
+				unsigned kind = unsigned(i * 0x9E3779B1u) % 10;
+				if		(kind < 7)	s.count (keys[i]);
+				else if (kind == 7) s.insert(keys[i]);
+				else if (kind == 8) s.erase (keys[i]);
+				else				s.scan	(keys[i], [](int) {}, 16);
+			}
+		}
+		ops = readTrace(out);
+	}
+
+	std::printf("replay: %zu ops from %s\n", ops.size(), traceFile ? traceFile : "TracedSet");
+	ReplayStats set = replay<Set<uint64_t>>(ops), std = replay<std::set<uint64_t>>(ops);
+	report(std::cout, "Set", set);
+	report(std::cout, "std::set", std);
+	std::cout << (set.checksum == std.checksum ? "  checksums agree\n" : "  CHECKSUMS DIFFER\n");
+}
+
+struct Bench {const char* name; void (*run)();};
+static const Bench benches[] = {
+	{"ingest",	ingest },
+	{"sharded", sharded},
+	{"window",	window },
+	{"build",	build  },
+	{"queue",	queue  },
+	{"policy",	policy },
+	{"finger",	finger },
+	{"range2d", range2d},
+	{"eraseif", eraseif},
+	{"relaxed", relaxed},
+	{"buckets", buckets},
+	{"replay",	replayTrace},
+};
+
+int main(int argc, char** argv) {
+	// Arg after "replay" that names no bench is its log
+	for (int i = 2; i < argc; i++) {
+		if (std::strcmp(argv[i - 1], "replay")) continue;
+		bool isBench = false;
+		for (const Bench& bench : benches) isBench |= !std::strcmp(argv[i], bench.name);
+		if (!isBench) traceFile = argv[i];
+	}
+
+	for (const Bench& bench : benches) {
+		bool toRun = argc < 2;
+		for (int i = 1; i < argc; i++) toRun |= !std::strcmp(argv[i], bench.name);
+		if (toRun) bench.run();
+	}
+}